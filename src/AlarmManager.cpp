@@ -0,0 +1,179 @@
+#include "AlarmManager.hpp"
+#include "AssetManager.hpp"
+#include "Instance.hpp"
+#include <algorithm>
+#include <vector>
+
+// Alarm phases are numbered from 1. Until a phase is over, this is still the number of the one before it.
+int64_t _phase = 0;
+bool _inPhase = false;
+
+// Tickets tell an alarm's current entry apart from ones left over from before it was last set
+unsigned int _nextTicket = 1;
+
+// Entries are filed under their phase modulo the wheel size. Ones further off than that just stay where they are until their phase comes
+// round. Entries are never taken out when their alarm's changed - they're thrown away when their phase comes and the ticket doesn't match.
+// They go by instance ID rather than handle, so that they stay good when persistent instances are carried into another room.
+constexpr unsigned int WHEEL_SIZE = 256;  // Must be a power of 2
+struct Entry {
+    InstanceID id;
+    unsigned int number;
+    unsigned int ticket;
+    int64_t phase;
+};
+std::vector<Entry> _wheel[WHEEL_SIZE];
+
+// The alarms going off in the phase that's running, in the order they go off
+struct Due {
+    unsigned int number;
+    unsigned int object;
+    size_t position;
+    InstanceHandle instance;
+    unsigned int ticket;
+};
+std::vector<Due> _due;
+size_t _dueNext;
+
+// Where the running phase has got to. Alarms before or at this point in the order have counted down this phase, and ones after it haven't.
+// Instances added since it got to this alarm number and object are past the end of that object's part of the order, so they count as before.
+unsigned int _cursorNumber;
+unsigned int _cursorObject;
+size_t _cursorPosition;
+size_t _cursorLimit;
+bool _cursorStarted;
+
+inline bool _dueBefore(const Due& a, const Due& b) {
+    if (a.number != b.number) return a.number < b.number;
+    if (a.object != b.object) return a.object < b.object;
+    return a.position < b.position;
+}
+
+// Whether an instance's object has an event for an alarm, which is what decides whether that alarm counts down
+inline bool _counts(const Instance& instance, unsigned int number) {
+    if (instance.object_index < 0 || instance.object_index >= static_cast<int>(AssetManager::GetObjectCount())) return false;
+    const std::vector<unsigned int>& events = AssetManager::GetObject(instance.object_index)->evList[2];
+    return std::binary_search(events.begin(), events.end(), number);
+}
+
+// Whether the running phase has yet to get to this alarm
+bool _ahead(unsigned int number, unsigned int object, size_t position) {
+    if (!_inPhase) return false;
+    if (!_cursorStarted) return true;
+    if (number != _cursorNumber) return number > _cursorNumber;
+    if (object != _cursorObject) return object > _cursorObject;
+    return position > _cursorPosition && position < _cursorLimit;
+}
+
+// How many phases have counted down one of an instance's alarms so far
+int64_t _phasesApplied(InstanceHandle instance, unsigned int number) {
+    if (!_inPhase) return _phase;
+    const Instance& inst = InstanceList::GetInstance(instance);
+    return _ahead(number, inst.object_index, InstanceList::GetPosition(instance)) ? _phase : _phase + 1;
+}
+
+void _schedule(InstanceHandle instance, unsigned int number) {
+    const Instance& inst = InstanceList::GetInstance(instance);
+    const InstanceAlarm& alarm = inst._alarms[number];
+    if (_inPhase && alarm.value == _phase + 1) {
+        // Going off in this phase, which can only happen when the phase hasn't got to it yet
+        Due due = {number, static_cast<unsigned int>(inst.object_index), InstanceList::GetPosition(instance), instance, alarm.ticket};
+        _due.insert(std::upper_bound(_due.begin() + _dueNext, _due.end(), due, _dueBefore), due);
+    }
+    else {
+        _wheel[alarm.value & (WHEEL_SIZE - 1)].push_back({inst.id, number, alarm.ticket, alarm.value});
+    }
+}
+
+int AlarmManager::Get(InstanceHandle instance, unsigned int number) {
+    if (number >= ALARM_COUNT) return -1;
+    const InstanceAlarm& alarm = InstanceList::GetInstance(instance)._alarms[number];
+    if (!alarm.ticket) return static_cast<int>(alarm.value);
+    // Alarms stop at -1 once they've gone off
+    return static_cast<int>(std::max<int64_t>(alarm.value - _phasesApplied(instance, number), -1));
+}
+
+void AlarmManager::Set(InstanceHandle instance, unsigned int number, int value) {
+    if (number >= ALARM_COUNT) return;
+    Instance& inst = InstanceList::GetInstance(instance);
+    InstanceAlarm& alarm = inst._alarms[number];
+    if (value < 0 || instance == InstanceList::DummyInstance || !_counts(inst, number)) {
+        alarm.value = value;
+        alarm.ticket = 0;
+        return;
+    }
+
+    alarm.value = _phasesApplied(instance, number) + value;
+    alarm.ticket = _nextTicket++;
+    if (!_nextTicket) _nextTicket = 1;
+    if (value > 0) _schedule(instance, number);
+}
+
+void AlarmManager::BeginPhase() {
+    _inPhase = true;
+    _cursorStarted = false;
+    _due.clear();
+    _dueNext = 0;
+
+    int64_t phase = _phase + 1;
+    std::vector<Entry>& slot = _wheel[phase & (WHEEL_SIZE - 1)];
+    size_t kept = 0;
+    for (const Entry& entry : slot) {
+        if (entry.phase > phase) {
+            slot[kept++] = entry;
+            continue;
+        }
+        if (entry.phase < phase) continue;
+
+        InstanceHandle instance = InstanceList::Iterator(entry.id).Next();
+        if (instance == InstanceList::NoInstance) continue;
+        const Instance& inst = InstanceList::GetInstance(instance);
+        if (inst._alarms[entry.number].ticket != entry.ticket) continue;
+        _due.push_back({entry.number, static_cast<unsigned int>(inst.object_index), InstanceList::GetPosition(instance), instance, entry.ticket});
+    }
+    slot.resize(kept);
+    std::sort(_due.begin(), _due.end(), _dueBefore);
+}
+
+bool AlarmManager::NextDue(InstanceHandle* instance, unsigned int* number) {
+    while (_dueNext < _due.size()) {
+        Due due = _due[_dueNext++];
+        if (!_cursorStarted || due.number != _cursorNumber || due.object != _cursorObject) _cursorLimit = InstanceList::Count();
+        _cursorStarted = true;
+        _cursorNumber = due.number;
+        _cursorObject = due.object;
+        _cursorPosition = due.position;
+
+        // Earlier alarm events might have destroyed the instance or set this alarm again
+        if (!InstanceList::IsValid(due.instance)) continue;
+        const Instance& inst = InstanceList::GetInstance(due.instance);
+        if (!inst.exists || inst._alarms[due.number].ticket != due.ticket) continue;
+
+        (*instance) = due.instance;
+        (*number) = due.number;
+        return true;
+    }
+    return false;
+}
+
+void AlarmManager::EndPhase() {
+    if (_dueNext < _due.size()) {
+        // Left early, so anything the phase hadn't got to yet has to go off a phase later than planned
+        InstanceList::Iterator iter;
+        InstanceHandle instance;
+        while ((instance = iter.Next()) != InstanceList::NoInstance) {
+            Instance& inst = InstanceList::GetInstance(instance);
+            size_t position = InstanceList::GetPosition(instance);
+            for (unsigned int number = 0; number < ALARM_COUNT; number++) {
+                InstanceAlarm& alarm = inst._alarms[number];
+                if (!alarm.ticket || !_ahead(number, inst.object_index, position)) continue;
+                alarm.value++;
+                alarm.ticket = _nextTicket++;
+                if (!_nextTicket) _nextTicket = 1;
+                if (alarm.value > _phase + 1) _wheel[alarm.value & (WHEEL_SIZE - 1)].push_back({inst.id, number, alarm.ticket, alarm.value});
+            }
+        }
+    }
+    _due.clear();
+    _phase++;
+    _inPhase = false;
+}
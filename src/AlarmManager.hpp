@@ -0,0 +1,19 @@
+#pragma once
+
+#include "InstanceList.hpp"
+
+// Alarms count down once a step, in the alarm phase, on instances whose object has an event for them. Instead of every instance being
+// checked each step, an alarm that's counting down is filed in a timing wheel under the phase it'll reach 0 in, so a phase only has to
+// look at the alarms that are actually going off.
+namespace AlarmManager {
+    // Gets or sets one of an instance's alarms. Numbers past the last alarm always read as -1, and setting them does nothing.
+    int Get(InstanceHandle instance, unsigned int number);
+    void Set(InstanceHandle instance, unsigned int number, int value);
+
+    // Runs the alarm phase of a step: call BeginPhase(), then run the alarm event for every instance and alarm NextDue() gives until it
+    // returns false, then call EndPhase(). They come in order of alarm number, then object, then position in the instance list.
+    // If the phase is left early, EndPhase() must still be called - alarms it never got to won't have counted down this step.
+    void BeginPhase();
+    bool NextDue(InstanceHandle* instance, unsigned int* number);
+    void EndPhase();
+};
@@ -139,17 +139,44 @@ unsigned int AssetManager::GetObjectCount() { return static_cast<unsigned int>(_
 unsigned int AssetManager::GetRoomCount() { return static_cast<unsigned int>(_rooms.size()); }
 unsigned int AssetManager::GetIncludeFileCount() { return static_cast<unsigned int>(_includeFiles.size()); }
 
+// Finds the event an object runs for a subevent: its own if it has one, otherwise its parent's, and so on. Collision events that still
+// aren't found are looked for again with the target's parent in place of the target, then that object's parent and so on.
+static bool _resolveEvent(const Object& obj, unsigned int ev, unsigned int sub, Object::ResolvedEvent* out) {
+    const unsigned int* targets = &sub;
+    size_t targetCount = 1;
+    if (ev == 4 && sub < _objects.size() && _objects[sub].identities.size() > 1) {
+        targets = _objects[sub].identities.data();
+        targetCount = _objects[sub].identities.size();
+    }
+
+    for (size_t t = 0; t < targetCount; t++) {
+        unsigned int target = targets[t];
+        for (unsigned int id : obj.identities) {
+            std::map<unsigned int, IndexedEvent>& events = _objects[id].events[ev];
+            auto e = events.find(target);
+            if (e != events.end()) {
+                out->event = &e->second;
+                out->sub = target;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
 void AssetManager::CompileObjectIdentities() {
     // Compile object identity lists and children lists
     for (unsigned int i = 0; i < _objects.size(); i++) {
         Object& obj = _objects[i];
         if (!obj.exists) continue;
-        obj.identities.insert(i);
+        obj.identities.assign(1, i);
         Object* o = &obj;
+        // Parent chains can't loop in GM8, but a broken game file could still have one, so stop at the first object that's already been seen
         while (o->parentIndex >= 0) {
-            obj.identities.insert(o->parentIndex);
+            if (std::find(obj.identities.begin(), obj.identities.end(), static_cast<unsigned int>(o->parentIndex)) != obj.identities.end()) break;
+            obj.identities.push_back(o->parentIndex);
             o = &_objects[o->parentIndex];
-            o->children.insert(i);
+            o->children.push_back(i);
         }
     }
 
@@ -160,15 +187,12 @@ void AssetManager::CompileObjectIdentities() {
 
         // event lists
         for (unsigned int j = 0; j < 12; j++) {
-            Object* o = &obj;
-            while (true) {
-                for (const auto& e : o->events[j]) {
+            for (unsigned int id : obj.identities) {
+                for (const auto& e : _objects[id].events[j]) {
                     if (std::find(obj.evList[j].begin(), obj.evList[j].end(), e.first) == obj.evList[j].end()) {
                         obj.evList[j].push_back(e.first);
                     }
                 }
-                if (o->parentIndex < 0) break;
-                o = &_objects[o->parentIndex];
             }
             std::sort(obj.evList[j].begin(), obj.evList[j].end());
             obj.evList[j].shrink_to_fit();
@@ -237,6 +261,39 @@ void AssetManager::CompileObjectIdentities() {
             }
         }
     }
+
+    // Resolve parented events into each object's dispatch tables
+    for (unsigned int i = 0; i < _objects.size(); i++) {
+        Object& obj = _objects[i];
+        if (!obj.exists) continue;
+
+        for (unsigned int j = 0; j < 12; j++) {
+            // Only subevents something in the parent chain has can run anything, except collisions, where any of their targets' children can too
+            std::vector<unsigned int> subs;
+            if (j == 4) {
+                bool hasCollisions = false;
+                for (unsigned int id : obj.identities) hasCollisions |= !_objects[id].events[4].empty();
+                if (hasCollisions) {
+                    for (unsigned int target = 0; target < _objects.size(); target++) subs.push_back(target);
+                }
+            }
+            else {
+                subs = obj.evList[j];
+            }
+
+            std::vector<std::pair<unsigned int, Object::ResolvedEvent>> resolved;
+            Object::ResolvedEvent event;
+            for (unsigned int sub : subs) {
+                if (_resolveEvent(obj, j, sub, &event)) resolved.push_back(std::make_pair(sub, event));
+            }
+            if (resolved.empty()) continue;
+
+            Object::EventTable& table = obj.dispatch[j];
+            table.first = resolved.front().first;
+            table.entries.assign(resolved.back().first - table.first + 1, {nullptr, 0});
+            for (const auto& r : resolved) table.entries[r.first - table.first] = r.second;
+        }
+    }
 }
 
 std::map<unsigned int, std::vector<unsigned int>>& AssetManager::GetEventHolderList(unsigned int ev) {
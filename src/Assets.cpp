@@ -1,5 +1,6 @@
 #include "Assets.hpp"
 #include "CodeActionManager.hpp"
+#include <algorithm>
 #include <cstddef>
 #include <cstdlib>
 
@@ -143,6 +144,16 @@ Timeline::~Timeline() {
     }
 }
 
+void Timeline::IndexMoments() {
+    momentIndex.clear();
+    momentIndex.reserve(moments.size());
+    for (auto& m : moments) momentIndex.push_back({m.first, &m.second});
+}
+
+size_t Timeline::FirstMoment(double position) const {
+    return std::lower_bound(momentIndex.begin(), momentIndex.end(), position, [](const Moment& m, double p) { return m.position < p; }) - momentIndex.begin();
+}
+
 Object::Object() {
     name = nullptr;
     exists = true;
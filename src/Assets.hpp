@@ -252,6 +252,18 @@ class Timeline {
 
     unsigned int momentCount;
     std::map<unsigned int, IndexedEvent> moments;
+
+    // The same moments as a sorted array, so that the ones in a range can be found by binary search. IndexMoments() fills it in
+    // once all the moments have been read.
+    struct Moment {
+        unsigned int position;
+        IndexedEvent* event;
+    };
+    std::vector<Moment> momentIndex;
+    void IndexMoments();
+
+    // Gets the first moment in momentIndex at or after a timeline position
+    size_t FirstMoment(double position) const;
 };
 
 class Object {
@@ -271,8 +283,27 @@ class Object {
 
     std::map<unsigned int, IndexedEvent> events[12];
     std::vector<unsigned int> evList[12];
-    std::set<unsigned int> identities;
-    std::set<unsigned int> children; // includes extended children
+    std::vector<unsigned int> identities;  // this object, then its parent, its parent's parent and so on
+    std::vector<unsigned int> children;    // includes extended children
+
+    // The event this object runs for each subevent, with parents' events already looked through, so that running one is a single lookup.
+    // Filled in by AssetManager::CompileObjectIdentities(). Each event type's table starts at the lowest subevent that runs anything.
+    struct ResolvedEvent {
+        IndexedEvent* event;  // nullptr if nothing runs for this subevent
+        unsigned int sub;     // The subevent it was found under - for collision events, this can be one of the target's parents
+    };
+    struct EventTable {
+        unsigned int first = 0;
+        std::vector<ResolvedEvent> entries;
+    };
+    EventTable dispatch[12];
+
+    // Gets the event that runs for an event type and subevent, or nullptr if there isn't one
+    inline const ResolvedEvent* GetEvent(unsigned int ev, unsigned int sub) const {
+        if (ev >= 12) return nullptr;
+        unsigned int i = sub - dispatch[ev].first;  // Wraps round for ones before the start, so those fail the check too
+        return (i < dispatch[ev].entries.size() && dispatch[ev].entries[i].event) ? &dispatch[ev].entries[i] : nullptr;
+    }
 };
 
 class Room {
@@ -0,0 +1,70 @@
+#include "CRGMLType.hpp"
+#include <string.h>
+
+GMLString::Block* GMLString::_make(const char* s, size_t length) {
+    if (!length) return nullptr;
+    Block* block = static_cast<Block*>(malloc(sizeof(Block) + length));
+    block->refs = 1;
+    block->length = static_cast<unsigned int>(length);
+    memcpy(block->chars, s, length);
+    block->chars[length] = '\0';
+    return block;
+}
+
+GMLString::GMLString(const char* s) : _block(_make(s, strlen(s))) {}
+
+GMLString& GMLString::operator+=(const GMLString& o) {
+    size_t rhsLength = o.length();
+    if (!rhsLength) return *this;
+    if (!_block) return (*this) = o;
+
+    size_t length = _block->length;
+    if (_block->refs == 1 && _block != o._block) {
+        _block = static_cast<Block*>(realloc(_block, sizeof(Block) + length + rhsLength));
+        _block->length = static_cast<unsigned int>(length + rhsLength);
+        memcpy(_block->chars + length, o._block->chars, rhsLength);
+        _block->chars[length + rhsLength] = '\0';
+        return *this;
+    }
+
+    Block* block = static_cast<Block*>(malloc(sizeof(Block) + length + rhsLength));
+    block->refs = 1;
+    block->length = static_cast<unsigned int>(length + rhsLength);
+    memcpy(block->chars, _block->chars, length);
+    memcpy(block->chars + length, o._block->chars, rhsLength);
+    block->chars[length + rhsLength] = '\0';
+    _release();
+    _block = block;
+    return *this;
+}
+
+int GMLString::compare(const GMLString& o) const {
+    size_t length = this->length();
+    size_t oLength = o.length();
+    int c = memcmp(c_str(), o.c_str(), length < oLength ? length : oLength);
+    if (c) return c;
+    return (length < oLength) ? -1 : ((length > oLength) ? 1 : 0);
+}
+
+const GMLType GMLArray::_unset;
+
+const GMLType& GMLArray::_readRow(unsigned int index) const {
+    unsigned int row = index / GML_ARRAY_SIZE;
+    unsigned int column = index % GML_ARRAY_SIZE;
+    if (row > _rows.size() || column >= _rows[row - 1].size()) return _unset;
+    return _rows[row - 1][column];
+}
+
+GMLType& GMLArray::_grow(unsigned int index) {
+    if (index < GML_ARRAY_SIZE) {
+        _row.resize(index);
+        return _row[index - 1];
+    }
+
+    unsigned int row = index / GML_ARRAY_SIZE;
+    unsigned int column = index % GML_ARRAY_SIZE;
+    if (row > _rows.size()) _rows.resize(row);
+    std::vector<GMLType>& r = _rows[row - 1];
+    if (column >= r.size()) r.resize(column + 1);
+    return r[column];
+}
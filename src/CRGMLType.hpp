@@ -1,12 +1,117 @@
 #pragma once
+#include <stddef.h>
+#include <stdlib.h>
 #include <string>
+#include <vector>
+
+// An immutable, reference-counted string. Copying one just bumps a count, and the empty string doesn't allocate at all.
+// The count isn't atomic, so any one string must only be used by one thread at a time.
+class GMLString {
+  private:
+    struct Block {
+        unsigned int refs;
+        unsigned int length;
+        char chars[1];
+    };
+    Block* _block;
+
+    static Block* _make(const char* s, size_t length);
+    inline void _release() {
+        if (_block && --_block->refs == 0) free(_block);
+    }
+
+  public:
+    GMLString() : _block(nullptr) {}
+    GMLString(const char* s);
+    GMLString(const char* s, size_t length) : _block(_make(s, length)) {}
+    GMLString(const std::string& s) : _block(_make(s.data(), s.length())) {}
+    GMLString(const GMLString& o) : _block(o._block) {
+        if (_block) _block->refs++;
+    }
+    GMLString(GMLString&& o) noexcept : _block(o._block) { o._block = nullptr; }
+    ~GMLString() { _release(); }
+
+    GMLString& operator=(const GMLString& o) {
+        if (o._block) o._block->refs++;
+        _release();
+        _block = o._block;
+        return *this;
+    }
+    GMLString& operator=(GMLString&& o) noexcept {
+        if (this != &o) {
+            _release();
+            _block = o._block;
+            o._block = nullptr;
+        }
+        return *this;
+    }
+    GMLString& operator=(const char* s) { return (*this) = GMLString(s); }
+    GMLString& operator=(const std::string& s) { return (*this) = GMLString(s); }
+
+    // Appending gives a new string, unless this is the only handle to the old one, in which case it's extended in place
+    GMLString& operator+=(const GMLString& o);
+
+    inline const char* c_str() const { return _block ? _block->chars : ""; }
+    inline size_t length() const { return _block ? _block->length : 0; }
+    inline size_t size() const { return length(); }
+    inline bool empty() const { return length() == 0; }
+    inline char operator[](size_t i) const { return c_str()[i]; }
+    inline void clear() {
+        _release();
+        _block = nullptr;
+    }
+    inline std::string str() const { return std::string(c_str(), length()); }
+
+    // Same result as std::string::compare
+    int compare(const GMLString& o) const;
+    inline bool operator==(const GMLString& o) const { return _block == o._block || compare(o) == 0; }
+    inline bool operator!=(const GMLString& o) const { return !((*this) == o); }
+};
 
 // States a GMLType can be in
-enum struct GMLTypeState { Double, String };
+enum struct GMLTypeState : unsigned char { Double, String };
 
-// The universal data type in GML
+// The universal data type in GML. The string handle sits before the double so this packs into 16 bytes on 32-bit targets.
 struct GMLType {
     GMLTypeState state = GMLTypeState::Double;
+    GMLString sVal;
     double dVal = 0.0;
-    std::string sVal;
+};
+
+// Each dimension of a GML array can only be indexed from 0 to 31999. 2D indices are flattened to (a1 * GML_ARRAY_SIZE) + a2.
+constexpr unsigned int GML_ARRAY_SIZE = 32000;
+
+// A GML array. Every variable is one - using it without an index is the same as using index 0, which is kept inline.
+// The rest of row 0 (that's all of a 1D array) is one contiguous vector, and each other row of a 2D array gets a vector of its own.
+// Elements that have never been set read as 0, as in GM8. Reading never grows anything; writing grows the row to fit.
+class GMLArray {
+  private:
+    GMLType _first;                           // [0]
+    std::vector<GMLType> _row;                // [1] to [31999], at _row[i - 1]
+    std::vector<std::vector<GMLType>> _rows;  // [r, c] for r >= 1, at _rows[r - 1][c]
+
+    static const GMLType _unset;
+    const GMLType& _readRow(unsigned int index) const;
+    GMLType& _grow(unsigned int index);
+
+  public:
+    // Indices are flattened, as above
+    inline const GMLType& Read(unsigned int index) const {
+        if (index == 0) return _first;
+        if (index <= _row.size()) return _row[index - 1];
+        if (index < GML_ARRAY_SIZE) return _unset;
+        return _readRow(index);
+    }
+    inline GMLType& Write(unsigned int index) {
+        if (index == 0) return _first;
+        if (index <= _row.size()) return _row[index - 1];
+        return _grow(index);
+    }
+
+    // Back to every element being unset. Row 0 keeps its space, so a reused local array doesn't have to allocate it again.
+    inline void Clear() {
+        _first = GMLType();
+        _row.clear();
+        _rows.clear();
+    }
 };
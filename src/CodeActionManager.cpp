@@ -15,6 +15,8 @@ namespace CodeActionManager {
       public:
         virtual bool Evaluate(InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, GMLType* out) = 0;
         virtual bool Compile() { return true; }
+        // Puts the code object this parameter runs in "out", if it has one
+        virtual bool GetCodeObject(CodeObject*) { return false; }
         virtual ~Parameter() {}
     };
 
@@ -27,6 +29,10 @@ namespace CodeActionManager {
         ~ParamExpression() {}
         virtual bool Evaluate(InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, GMLType* out) { return CodeManager::Query(_exp, self, other, ev, sub, asObjId, out); }
         virtual bool Compile() override { return CodeManager::Compile(_exp); }
+        virtual bool GetCodeObject(CodeObject* out) override {
+            (*out) = _exp;
+            return true;
+        }
     };
 
     class ParamGML : public Parameter {
@@ -38,6 +44,10 @@ namespace CodeActionManager {
         ~ParamGML() {}
         virtual bool Evaluate(InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, GMLType* out) { return CodeManager::Run(_code, self, other, ev, sub, asObjId); }
         virtual bool Compile() override { return true; /*return CodeManager::Compile(_code);*/ }
+        virtual bool GetCodeObject(CodeObject* out) override {
+            (*out) = _code;
+            return true;
+        }
     };
 
     class ParamLiteral : public Parameter {
@@ -580,11 +590,22 @@ bool CodeActionManager::Compile(CodeAction action) {
     return CodeManager::Compile(_actions[action].codeObj);
 }
 
+void CodeActionManager::GetCodeObjects(const CodeAction* actions, unsigned int count, std::vector<CodeObject>& out) {
+    for (unsigned int i = 0; i < count; i++) {
+        CACodeAction& action = _actions[actions[i]];
+        for (unsigned int j = 0; j < action.paramCount; j++) {
+            CodeObject obj;
+            if (action.params[j]->GetCodeObject(&obj)) out.push_back(obj);
+        }
+        out.push_back(action.codeObj);
+    }
+}
+
 bool CodeActionManager::Run(CodeAction* actions, unsigned int count, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId) {
     unsigned int pos = 0;
+    GMLType args[8];
     while (pos < count) {
         bool run = true;
-        GMLType args[8];
 
         if (_actions[actions[pos]].question) {
             // Multiple questions can be chained together with the end statement dependent on all of them.
@@ -652,26 +673,9 @@ bool CodeActionManager::Run(CodeAction* actions, unsigned int count, InstanceHan
 
 
 bool CodeActionManager::RunInstanceEvent(int ev, int sub, InstanceHandle self, InstanceHandle other, unsigned int asObjId) {
-    // Resolve parented events
-    Object* o = AssetManager::GetObject(asObjId);
-    while (!CheckObjectEvent(ev, sub, o)) {
-        if (o->parentIndex < 0) {
-            if (ev == 4) {  // Collision event, parent the target
-                int targetParent = AssetManager::GetObject(sub)->parentIndex;
-                if (targetParent < 0) return true;
-                o = AssetManager::GetObject(asObjId);
-                sub = targetParent;
-            }
-            else
-                return true;
-        }
-        else {
-            o = AssetManager::GetObject(o->parentIndex);
-        }
-    }
-
-    // Run event
-    return o->events[ev].count(sub) ? Run(o->events[ev][sub].actions, o->events[ev][sub].actionCount, self, other, ev, sub, asObjId) : true;
+    // Parented events were all resolved when the game was loaded
+    const Object::ResolvedEvent* event = AssetManager::GetObject(asObjId)->GetEvent(ev, sub);
+    return event ? Run(event->event->actions, event->event->actionCount, self, other, ev, event->sub, asObjId) : true;
 }
 
 
@@ -20,6 +20,9 @@ namespace CodeActionManager {
     // Only do this after the asset list is fully loaded.
     bool Compile(CodeAction action);
 
+    // Gets every code object that Compile() would compile for these actions.
+    void GetCodeObjects(const CodeAction* actions, unsigned int count, std::vector<CodeObject>& out);
+
     // Run a list of actions. Returns true on success, false on error (ie. game should close.)
     bool Run(CodeAction* actions, unsigned int count, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId);
 
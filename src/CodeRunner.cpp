@@ -3,33 +3,55 @@
 #include "CREnums.hpp"
 #include "CRGMLType.hpp"
 #include "CodeActionManager.hpp"
+#include "Compiler/Bytecode.hpp"
 #include "Compiler/CRRuntime.hpp"
-#include "Compiler/Compiled.hpp"
 #include "Compiler/Interpreter.hpp"
 #include "Compiler/Tokenizer.hxx"
 #include "InstanceList.hpp"
 #include "RNG.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
 
 // Internal code object
 struct CRCodeObject {
+    enum Status : unsigned char { NotCompiled, Compiling, Compiled, Failed };
+
     char* _code;
-    GM8Emulator::Compiler::TokenList _tokenized;
+    unsigned int _length;
     bool question;
-    CRActionList _actions;
-    CRExpression _expression;
-    CRCodeObject(const char* c, unsigned int l, bool q) : question(q) {
+    bool wanted;  // Compile() has been called on it
+    std::atomic<unsigned char> status;
+    CRBytecode _bytecode;
+    std::vector<unsigned int> _fields;  // Fields used on its own instance, found by CompileAll()
+    CRCodeObject(const char* c, unsigned int l, bool q) : _length(l), question(q), wanted(false), status(NotCompiled) {
         _code = ( char* )malloc(l);
         memcpy(_code, c, l);
-        _tokenized = GM8Emulator::Compiler::TokenList(_code, l);
     }
+    CRCodeObject(const CRCodeObject& o)
+        : _code(o._code), _length(o._length), question(o.question), wanted(o.wanted), status(o.status.load()), _bytecode(o._bytecode), _fields(o._fields) {}
 };
 std::vector<CRCodeObject> _codeObjects;
 
 // Global game value settings
 GlobalValues* _crGlobalValues;
 
+// Compiling can happen on any thread. Threads which find an object already being compiled wait on _compileDone.
+bool _lazyCompilation = false;
+bool _compiledAll = false;
+std::mutex _compileMutex;
+std::condition_variable _compileDone;
+std::thread _warmThread;
+std::mutex _warmMutex;
+std::condition_variable _warmSignal;
+std::deque<CodeObject> _warmQueue;
+bool _warmStop = false;
+
 bool CodeManager::Init(GlobalValues* globals) {
     _crGlobalValues = globals;
     RNG::Randomize();
@@ -37,13 +59,16 @@ bool CodeManager::Init(GlobalValues* globals) {
 }
 
 void CodeManager::Finalize() {
-    for (CRCodeObject& obj : _codeObjects) {
-        if (obj.question) {
-            obj._expression.Finalize();
-        }
-        else {
-            obj._actions.Finalize();
+    if (_warmThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_warmMutex);
+            _warmStop = true;
         }
+        _warmSignal.notify_all();
+        _warmThread.join();
+    }
+
+    for (CRCodeObject& obj : _codeObjects) {
         free(obj._code);
     }
     Runtime::Finalize();
@@ -63,36 +88,167 @@ CodeObject CodeManager::RegisterQuestion(const char* code, unsigned int len) {
     return ix;
 }
 
-bool CodeManager::Compile(CodeObject object) {
+// Claims an object so this thread can compile it. If another thread has already claimed it, this waits for it to finish and returns false.
+bool _claim(CRCodeObject& obj) {
+    unsigned char expected = CRCodeObject::NotCompiled;
+    if (obj.status.compare_exchange_strong(expected, CRCodeObject::Compiling, std::memory_order_acq_rel)) return true;
+    if (expected == CRCodeObject::Compiling) {
+        std::unique_lock<std::mutex> lock(_compileMutex);
+        _compileDone.wait(lock, [&obj] { return obj.status.load(std::memory_order_acquire) != CRCodeObject::Compiling; });
+    }
+    return false;
+}
+
+// Compiles a claimed object from its tokens
+bool _interpret(CRCodeObject& obj, const GM8Emulator::Compiler::TokenList& tokens) {
+    bool success;
     try {
-        if (_codeObjects[object].question) {
-            if (!GM8Emulator::Compiler::InterpretExpression(_codeObjects[object]._tokenized, &_codeObjects[object]._expression)) return false;
+        if (obj.question) {
+            success = GM8Emulator::Compiler::CompileExpression(tokens, &obj._bytecode);
         }
         else {
-            if (!GM8Emulator::Compiler::Interpret(_codeObjects[object]._tokenized, &_codeObjects[object]._actions)) return false;
+            success = GM8Emulator::Compiler::Compile(tokens, &obj._bytecode);
         }
-        GM8Emulator::Compiler::FlushLocals();
-        return true;
     }
     catch (const std::runtime_error&) {
-        return false;
+        success = false;
+    }
+    GM8Emulator::Compiler::FlushLocals();
+
+    {
+        std::lock_guard<std::mutex> lock(_compileMutex);
+        obj.status.store(success ? CRCodeObject::Compiled : CRCodeObject::Failed, std::memory_order_release);
+    }
+    _compileDone.notify_all();
+    return success;
+}
+
+// Compiles an object if it hasn't been yet. The source is only tokenized here, and the tokens are thrown away again afterwards.
+bool _compile(CRCodeObject& obj) {
+    if (_claim(obj)) {
+        GM8Emulator::Compiler::TokenList tokens(obj._code, obj._length);
+        return _interpret(obj, tokens);
+    }
+    return obj.status.load(std::memory_order_acquire) == CRCodeObject::Compiled;
+}
+
+// Calls work(i) for every i below count, using all the cores there are. Each thread takes the next index as soon as it's free,
+// so a few big code objects don't hold the rest up.
+template <typename F>
+void _parallelFor(size_t count, F work) {
+    size_t threadCount = std::min(static_cast<size_t>(std::thread::hardware_concurrency()), count);
+    if (threadCount <= 1) {
+        for (size_t i = 0; i < count; i++) work(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    auto loop = [&next, &work, count]() {
+        size_t i;
+        while ((i = next.fetch_add(1, std::memory_order_relaxed)) < count) work(i);
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) threads.emplace_back(loop);
+    loop();
+    for (std::thread& t : threads) t.join();
+}
+
+// Makes sure an object is ready to run. Objects which were never passed to Compile() are left alone, as they always have been.
+bool _prepare(CRCodeObject& obj) {
+    if (obj.status.load(std::memory_order_acquire) == CRCodeObject::Compiled || !obj.wanted) return true;
+    if (_compile(obj)) return true;
+    Runtime::SetReturnCause(Runtime::ReturnCause::ExitError);
+    Runtime::PushErrorMessage("Failed to compile GML code");
+    return false;
+}
+
+void _warmLoop() {
+    std::unique_lock<std::mutex> lock(_warmMutex);
+    while (true) {
+        _warmSignal.wait(lock, [] { return _warmStop || !_warmQueue.empty(); });
+        if (_warmStop) return;
+
+        CodeObject object = _warmQueue.front();
+        _warmQueue.pop_front();
+        lock.unlock();
+        _compile(_codeObjects[object]);
+        lock.lock();
+    }
+}
+
+void CodeManager::SetLazyCompilation(bool lazy) { _lazyCompilation = lazy; }
+
+bool CodeManager::Compile(CodeObject object) {
+    _codeObjects[object].wanted = true;
+    if (_lazyCompilation || !_compiledAll) return true;
+    return _compile(_codeObjects[object]);
+}
+
+bool CodeManager::CompileAll() {
+    _compiledAll = true;
+    GM8Emulator::Compiler::IndexAssets();
+
+    // Lazily compiled objects are tokenized the first time they run, and register their field names then
+    if (_lazyCompilation) return true;
+
+    std::vector<CodeObject> objects;
+    for (CodeObject i = 0; i < _codeObjects.size(); i++) {
+        if (_codeObjects[i].wanted && _codeObjects[i].status.load(std::memory_order_relaxed) == CRCodeObject::NotCompiled) objects.push_back(i);
+    }
+
+    // One pass over the whole list, so worker threads are only started once. Each object is tokenized, scanned for fields and compiled
+    // by the same thread, so there's only ever one token list per thread alive.
+    _parallelFor(objects.size(), [&](size_t i) {
+        CRCodeObject& obj = _codeObjects[objects[i]];
+        if (!_claim(obj)) return;
+        GM8Emulator::Compiler::TokenList tokens(obj._code, obj._length);
+        GM8Emulator::Compiler::RegisterFields(tokens, &obj._fields);
+        _interpret(obj, tokens);
+    });
+
+    for (CodeObject object : objects) {
+        if (_codeObjects[object].status.load(std::memory_order_relaxed) == CRCodeObject::Failed) return false;
+    }
+    return true;
+}
+
+void CodeManager::GetFields(CodeObject object, std::vector<unsigned int>& out) {
+    const std::vector<unsigned int>& fields = _codeObjects[object]._fields;
+    out.insert(out.end(), fields.begin(), fields.end());
+}
+
+void CodeManager::Warm(const std::vector<CodeObject>& objects) {
+    // With only one core, a background thread would just be taking time away from the game
+    if (!_lazyCompilation || std::thread::hardware_concurrency() <= 1) return;
+    {
+        std::lock_guard<std::mutex> lock(_warmMutex);
+        for (CodeObject object : objects) {
+            if (_codeObjects[object].wanted && _codeObjects[object].status.load(std::memory_order_relaxed) == CRCodeObject::NotCompiled) {
+                _warmQueue.push_back(object);
+            }
+        }
+        if (!_warmThread.joinable()) _warmThread = std::thread(_warmLoop);
     }
+    _warmSignal.notify_all();
 }
 
 bool CodeManager::Run(CodeObject code, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, unsigned int argc, GMLType* argv) {
-    return Runtime::Execute(_codeObjects[code]._actions, self, other, ev, sub, asObjId, argc, argv);
+    if (!_prepare(_codeObjects[code])) return false;
+    return Runtime::Execute(_codeObjects[code]._bytecode, self, other, ev, sub, asObjId, argc, argv);
 }
 
 bool CodeManager::Query(CodeObject code, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, bool* response, unsigned int argc, GMLType* argv) {
+    if (!_prepare(_codeObjects[code])) return false;
     GMLType t;
-    if (!Runtime::EvalExpression(_codeObjects[code]._expression, self, other, ev, sub, asObjId, &t, argc, argv)) return false;
+    if (!Runtime::EvalExpression(_codeObjects[code]._bytecode, self, other, ev, sub, asObjId, &t, argc, argv)) return false;
     (*response) = Runtime::_isTrue(&t);
     return true;
 }
 
 bool CodeManager::Query(CodeObject code, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, GMLType* response) {
+    if (!_prepare(_codeObjects[code])) return false;
     GMLType t;
-    if (!Runtime::EvalExpression(_codeObjects[code]._expression, self, other, ev, sub, asObjId, &t)) return false;
+    if (!Runtime::EvalExpression(_codeObjects[code]._bytecode, self, other, ev, sub, asObjId, &t)) return false;
     (*response) = t;
     return true;
 }
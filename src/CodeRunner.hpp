@@ -1,8 +1,10 @@
 #pragma once
 
+#include <vector>
+
 struct GlobalValues;
 struct GMLType;
-enum struct GMLTypeState;
+enum struct GMLTypeState : unsigned char;
 typedef unsigned int CodeObject;
 typedef unsigned int InstanceID;
 typedef unsigned int InstanceHandle;
@@ -24,9 +26,24 @@ namespace CodeManager {
     CodeObject RegisterQuestion(const char* code, unsigned int length);
 
     // Compile a code object that has been returned by Register(). Returns true on success, false on error (ie. game should close.)
-    // Be sure to call this only after the AssetManager is fully loaded.
+    // Be sure to call this only after the AssetManager is fully loaded. Until CompileAll() has been called, this only marks the object to be compiled.
     bool Compile(CodeObject object);
 
+    // Compiles everything that's been passed to Compile() so far, using every core available. Returns true on success, false if any object failed.
+    // With lazy compilation on, this doesn't do anything: not even tokenizing happens until an object first runs.
+    bool CompileAll();
+
+    // Adds the numbers of the fields this code uses on its own instance to the output vector. Only known for objects that CompileAll() compiled,
+    // so with lazy compilation this adds nothing, and instances keep all their fields in their hash table.
+    void GetFields(CodeObject object, std::vector<unsigned int>& out);
+
+    // Turns lazy compilation on or off. While it's on, Compile() only marks the object as needing to be compiled, and it actually gets compiled
+    // the first time it's Run() or Query()d. Compile errors then show up as runtime errors.
+    void SetLazyCompilation(bool lazy);
+
+    // Compiles these objects on a background thread, ahead of them being run. Only does anything with lazy compilation on.
+    void Warm(const std::vector<CodeObject>& objects);
+
     // Run a compiled code object. Returns true on success, false on error (ie. the game should close.)
     // Most be passed the instance ID of the "self" and "other" instances in this context. (both may be NULL)
     // ev and sub indicate the event that's being run. For more info, check the "COMPILED OBJECT EVENTS" section of notes.txt
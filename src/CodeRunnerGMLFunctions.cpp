@@ -1,3 +1,4 @@
+#include "AlarmManager.hpp"
 #include "AssetManager.hpp"
 #include "CRGMLType.hpp"
 #include "CodeActionManager.hpp"
@@ -219,7 +220,7 @@ bool Runtime::draw_self(unsigned int argc, GMLType* argv, GMLType* out) {
     if (self.sprite_index < 0) return true;
     Sprite* spr = AssetManager::GetSprite(self.sprite_index);
     if (spr->exists) {
-        RDrawImage(spr->frames[static_cast<int>(self.image_index) % spr->frameCount], self.x, self.y, self.image_xscale, self.image_yscale, self.image_angle, self.image_blend, self.image_alpha);
+        RDrawImage(spr->frames[static_cast<int>(self.image_index()) % spr->frameCount], self.x(), self.y(), self.image_xscale, self.image_yscale, self.image_angle, self.image_blend, self.image_alpha);
     }
     return true;
 }
@@ -259,7 +260,7 @@ bool Runtime::draw_sprite(unsigned int argc, GMLType* argv, GMLType* out) {
     Sprite* spr = AssetManager::GetSprite(_round(argv[0].dVal));
     Instance& self = InstanceList::GetInstance(GetContext().self);
     int frame = _round(argv[1].dVal);
-    if (frame < 0) frame = static_cast<int>(::floor(self.image_index));
+    if (frame < 0) frame = static_cast<int>(::floor(self.image_index()));
     RDrawImage(spr->frames[frame % spr->frameCount], argv[2].dVal, argv[3].dVal, 1.0, 1.0, 0.0, 0xFFFFFFFF, 1.0);
     return true;
 }
@@ -271,7 +272,7 @@ bool Runtime::draw_sprite_ext(unsigned int argc, GMLType* argv, GMLType* out) {
     Sprite* spr = AssetManager::GetSprite(_round(argv[0].dVal));
     Instance& self = InstanceList::GetInstance(GetContext().self);
     int frame = _round(argv[1].dVal);
-    if (frame < 0) frame = static_cast<int>(::floor(self.image_index));
+    if (frame < 0) frame = static_cast<int>(::floor(self.image_index()));
     RDrawImage(spr->frames[frame % spr->frameCount], argv[2].dVal, argv[3].dVal, argv[4].dVal, argv[5].dVal, argv[6].dVal, _round(argv[7].dVal), argv[8].dVal);
     return true;
 }
@@ -385,7 +386,7 @@ bool Runtime::event_perform(unsigned int argc, GMLType* argv, GMLType* out) {
 
 // --- FILE ---
 // removed filesystem for now because mingw is a broken piece of shit
-bool fsExists(std::string& path) {
+bool fsExists(const std::string& path) {
     std::ifstream ifs(path);
     return ifs.good() && ifs.is_open();
 }
@@ -394,7 +395,7 @@ bool Runtime::file_bin_open(unsigned int argc, GMLType* argv, GMLType* out) {
     if (!_assertArgs(argc, argv, 2, true, GMLTypeState::String, GMLTypeState::Double)) return false;
     // fs::path filePath = fs::path(argv[0].sVal);
 
-    ::std::string filePath = argv[0].sVal;
+    ::std::string filePath = argv[0].sVal.str();
     int fileType = _round(argv[1].dVal);
     bool exists = fsExists(filePath);
 
@@ -517,7 +518,7 @@ bool Runtime::file_exists(unsigned int argc, GMLType* argv, GMLType* out) {
             out->dVal = 0.0;
         }
         else {
-            out->dVal = (fsExists(argv[0].sVal) ? GMLTrue : GMLFalse);
+            out->dVal = (fsExists(argv[0].sVal.str()) ? GMLTrue : GMLFalse);
         }
     }
     return true;
@@ -553,25 +554,25 @@ bool Runtime::instance_change(unsigned int argc, GMLType* argv, GMLType* out) {
     // Note: this does leave the current "self" instance non-existent, as if we had called instance_destroy().
     // The self does NOT get updated to the new instance at any time.
     self.exists = false;
-    InstanceHandle newInstanceHandle = InstanceList::AddInstance(self.x, self.y, objId);
+    InstanceHandle newInstanceHandle = InstanceList::AddInstance(self.x(), self.y(), objId);
     Instance& newInstance = InstanceList::GetInstance(newInstanceHandle);
 
     // InstanceList::AddInstance might have invalidated our reference, so we need a new one...
     Instance& self2 = InstanceList::GetInstance(GetContext().self);
 
     // Some variables are updated and some aren't...
-    newInstance._fields = self2._fields;
-    newInstance._alarms = self2._alarms;
-    newInstance.gravity = self2.gravity;
-    newInstance.gravity_direction = self2.gravity_direction;
-    newInstance.hspeed = self2.hspeed;
-    newInstance.vspeed = self2.vspeed;
-    newInstance.speed = self2.speed;
-    newInstance.direction = self2.direction;
-    newInstance.friction = self2.friction;
+    newInstance._fields.CopyFrom(self2._fields);
+    for (unsigned int i = 0; i < ALARM_COUNT; i++) AlarmManager::Set(newInstanceHandle, i, AlarmManager::Get(GetContext().self, i));
+    newInstance.gravity() = self2.gravity();
+    newInstance.gravity_direction() = self2.gravity_direction();
+    newInstance.hspeed() = self2.hspeed();
+    newInstance.vspeed() = self2.vspeed();
+    newInstance.speed() = self2.speed();
+    newInstance.direction() = self2.direction();
+    newInstance.friction() = self2.friction();
     newInstance.image_xscale = self2.image_xscale;
     newInstance.image_yscale = self2.image_yscale;
-    newInstance.image_speed = self2.image_speed;
+    newInstance.image_speed() = self2.image_speed();
     newInstance.image_angle = self2.image_angle;
     newInstance.image_blend = self2.image_blend;
 
@@ -623,7 +624,7 @@ bool Runtime::instance_nearest(unsigned int argc, GMLType* argv, GMLType* out) {
     InstanceHandle inst;
     while ((inst = it.Next()) != InstanceList::NoInstance) {
         Instance& other = InstanceList::GetInstance(inst);
-        double dist = ::sqrt(::pow(oX - other.x, 2) + ::pow(oY - other.y, 2));
+        double dist = ::sqrt(::pow(oX - other.x(), 2) + ::pow(oY - other.y(), 2));
         if(dist < nearestDist) {
             nearestDist = dist;
             nearestID = other.id;
@@ -653,11 +654,11 @@ bool Runtime::instance_place(unsigned int argc, GMLType* argv, GMLType* out) {
     if (!_assertArgs(argc, argv, 3, true, GMLTypeState::Double, GMLTypeState::Double, GMLTypeState::Double)) return false;
     if (out) {
         Instance& self = InstanceList::GetInstance(GetContext().self);
-        double oldX = self.x;
-        double oldY = self.y;
-        self.x = argv[0].dVal;
-        self.y = argv[1].dVal;
-        self.bboxIsStale = true;
+        double oldX = self.x();
+        double oldY = self.y();
+        self.x() = argv[0].dVal;
+        self.y() = argv[1].dVal;
+        self.bboxIsStale() = true;
 
         int objId = _round(argv[2].dVal);
         InstanceList::Iterator it(static_cast<unsigned int>(objId));
@@ -675,9 +676,9 @@ bool Runtime::instance_place(unsigned int argc, GMLType* argv, GMLType* out) {
         out->state = GMLTypeState::Double;
         out->dVal = ret;
 
-        self.x = oldX;
-        self.y = oldY;
-        self.bboxIsStale = true;
+        self.x() = oldX;
+        self.y() = oldY;
+        self.bboxIsStale() = true;
     }
     return true;
 }
@@ -995,8 +996,8 @@ bool Runtime::min(unsigned int argc, GMLType* argv, GMLType* out) {
 bool Runtime::motion_set(unsigned int argc, GMLType* argv, GMLType* out) {
     if (!_assertArgs(argc, argv, 2, true, GMLTypeState::Double, GMLTypeState::Double)) return false;
     Instance& self = InstanceList::GetInstance(GetContext().self);
-    self.direction = argv[0].dVal;
-    self.speed = argv[1].dVal;
+    self.direction() = argv[0].dVal;
+    self.speed() = argv[1].dVal;
     return true;
 }
 
@@ -1009,19 +1010,19 @@ bool Runtime::move_bounce_solid(unsigned int argc, GMLType* argv, GMLType* out)
     else {
         // Basic bouncing
         Instance& self = InstanceList::GetInstance(GetContext().self);
-        double startx = self.x, starty = self.y;
+        double startx = self.x(), starty = self.y();
         InstanceHandle target;
 
         // First collision check - x offset only
-        self.x += self.hspeed;
-        self.bboxIsStale = true;
+        self.x() += self.hspeed();
+        self.bboxIsStale() = true;
         bool didChange = false;
         InstanceList::Iterator iter;
         while ((target = iter.Next()) != InstanceList::NoInstance) {
             Instance& targetInst = InstanceList::GetInstance(target);
             if (targetInst.solid) {
                 if (CollisionCheck(&self, &targetInst)) {
-                    self.hspeed = -self.hspeed;
+                    self.hspeed() = -self.hspeed();
                     didChange = true;
                     break;
                 }
@@ -1029,15 +1030,15 @@ bool Runtime::move_bounce_solid(unsigned int argc, GMLType* argv, GMLType* out)
         }
 
         // Second collision check - y offset only
-        self.x = startx;
-        self.y += self.vspeed;
-        self.bboxIsStale = true;
+        self.x() = startx;
+        self.y() += self.vspeed();
+        self.bboxIsStale() = true;
         iter = InstanceList::Iterator();
         while ((target = iter.Next()) != InstanceList::NoInstance) {
             Instance& targetInst = InstanceList::GetInstance(target);
             if (targetInst.solid) {
                 if (CollisionCheck(&self, &targetInst)) {
-                    self.vspeed = -self.vspeed;
+                    self.vspeed() = -self.vspeed();
                     didChange = true;
                     break;
                 }
@@ -1046,15 +1047,15 @@ bool Runtime::move_bounce_solid(unsigned int argc, GMLType* argv, GMLType* out)
 
         if (!didChange) {
             // Third collision check - x and y offset
-            self.x += self.hspeed;
-            self.bboxIsStale = true;
+            self.x() += self.hspeed();
+            self.bboxIsStale() = true;
             iter = InstanceList::Iterator();
             while ((target = iter.Next()) != InstanceList::NoInstance) {
                 Instance& targetInst = InstanceList::GetInstance(target);
                 if(targetInst.solid) {
                     if (CollisionCheck(&self, &targetInst)) {
-                        self.hspeed = -self.hspeed;
-                        self.vspeed = -self.vspeed;
+                        self.hspeed() = -self.hspeed();
+                        self.vspeed() = -self.vspeed();
                         didChange = true;
                         break;
                     }
@@ -1062,13 +1063,13 @@ bool Runtime::move_bounce_solid(unsigned int argc, GMLType* argv, GMLType* out)
             }
         }
 
-        self.x = startx;
-        self.y = starty;
-        self.bboxIsStale = true;
+        self.x() = startx;
+        self.y() = starty;
+        self.bboxIsStale() = true;
 
         if (didChange) {
-            self.direction = ::atan2(-self.vspeed * GML_PI / 180.0, self.hspeed * GML_PI / 180.0) * 180.0 / GML_PI;
-            self.speed = ::sqrt(pow(self.hspeed, 2) + pow(self.vspeed, 2));
+            self.direction() = ::atan2(-self.vspeed() * GML_PI / 180.0, self.hspeed() * GML_PI / 180.0) * 180.0 / GML_PI;
+            self.speed() = ::sqrt(pow(self.hspeed(), 2) + pow(self.vspeed(), 2));
         }
 
         return true;
@@ -1101,17 +1102,17 @@ bool Runtime::move_contact_solid(unsigned int argc, GMLType* argv, GMLType* out)
 
         if (collision) {
             if (moved) {
-                self.x -= hspeed;
-                self.y -= vspeed;
-                self.bboxIsStale = true;
+                self.x() -= hspeed;
+                self.y() -= vspeed;
+                self.bboxIsStale() = true;
             }
             break;
         }
         else {
             if (i != maxdist) {
-                self.x += hspeed;
-                self.y += vspeed;
-                self.bboxIsStale = true;
+                self.x() += hspeed;
+                self.y() += vspeed;
+                self.bboxIsStale() = true;
                 moved = true;
             }
             else {
@@ -1125,10 +1126,10 @@ bool Runtime::move_contact_solid(unsigned int argc, GMLType* argv, GMLType* out)
 bool Runtime::move_towards_point(unsigned int argc, GMLType* argv, GMLType* out) {
     if (!_assertArgs(argc, argv, 3, true, GMLTypeState::Double, GMLTypeState::Double, GMLTypeState::Double)) return false;
     Instance& i = InstanceList::GetInstance(GetContext().self);
-    i.direction = (::atan2((i.y - argv[1].dVal), (argv[0].dVal - i.x))) * 180.0 / GML_PI;
-    i.speed = argv[2].dVal;
-    i.hspeed = ::cos(i.direction * GML_PI / 180.0) * i.speed;
-    i.vspeed = -::sin(i.direction * GML_PI / 180.0) * i.speed;
+    i.direction() = (::atan2((i.y() - argv[1].dVal), (argv[0].dVal - i.x()))) * 180.0 / GML_PI;
+    i.speed() = argv[2].dVal;
+    i.hspeed() = ::cos(i.direction() * GML_PI / 180.0) * i.speed();
+    i.vspeed() = -::sin(i.direction() * GML_PI / 180.0) * i.speed();
     return true;
 }
 
@@ -1141,21 +1142,21 @@ bool Runtime::move_wrap(unsigned int argc, GMLType* argv, GMLType* out) {
 
     if (hor) {
         unsigned int roomW = AssetManager::GetRoom(GetGlobals()->room)->width;
-        if (instance.x < -margin) {
-            instance.x += roomW;
+        if (instance.x() < -margin) {
+            instance.x() += roomW;
         }
-        else if (instance.x >= (roomW + margin)) {
-            instance.x -= roomW;
+        else if (instance.x() >= (roomW + margin)) {
+            instance.x() -= roomW;
         }
     }
 
     if (ver) {
         unsigned int roomH = AssetManager::GetRoom(GetGlobals()->room)->height;
-        if (instance.y < -margin) {
-            instance.y += roomH;
+        if (instance.y() < -margin) {
+            instance.y() += roomH;
         }
-        else if (instance.y >= (roomH + margin)) {
-            instance.y -= roomH;
+        else if (instance.y() >= (roomH + margin)) {
+            instance.y() -= roomH;
         }
     }
 
@@ -1179,11 +1180,11 @@ bool Runtime::place_free(unsigned int argc, GMLType* argv, GMLType* out) {
 
         InstanceList::Iterator iter;
         Instance& self = InstanceList::GetInstance(GetContext().self);
-        double oldX = self.x;
-        double oldY = self.y;
-        self.x = argv[0].dVal;
-        self.y = argv[1].dVal;
-        self.bboxIsStale = true;
+        double oldX = self.x();
+        double oldY = self.y();
+        self.x() = argv[0].dVal;
+        self.y() = argv[1].dVal;
+        self.bboxIsStale() = true;
 
         InstanceHandle target;
         while ((target = iter.Next()) != InstanceList::NoInstance) {
@@ -1196,9 +1197,9 @@ bool Runtime::place_free(unsigned int argc, GMLType* argv, GMLType* out) {
             }
         }
 
-        self.x = oldX;
-        self.y = oldY;
-        self.bboxIsStale = true;
+        self.x() = oldX;
+        self.y() = oldY;
+        self.bboxIsStale() = true;
     }
     return true;
 }
@@ -1213,11 +1214,11 @@ bool Runtime::place_meeting(unsigned int argc, GMLType* argv, GMLType* out) {
         if (obj == -3) iter = InstanceList::Iterator();
 
         Instance& self = InstanceList::GetInstance(GetContext().self);
-        double oldX = self.x;
-        double oldY = self.y;
-        self.x = argv[0].dVal;
-        self.y = argv[1].dVal;
-        self.bboxIsStale = true;
+        double oldX = self.x();
+        double oldY = self.y();
+        self.x() = argv[0].dVal;
+        self.y() = argv[1].dVal;
+        self.bboxIsStale() = true;
 
         InstanceHandle target;
         while ((target = iter.Next()) != InstanceList::NoInstance) {
@@ -1230,9 +1231,9 @@ bool Runtime::place_meeting(unsigned int argc, GMLType* argv, GMLType* out) {
             }
         }
 
-        self.x = oldX;
-        self.y = oldY;
-        self.bboxIsStale = true;
+        self.x() = oldX;
+        self.y() = oldY;
+        self.bboxIsStale() = true;
     }
     return true;
 }
@@ -1422,7 +1423,7 @@ bool Runtime::string_width(unsigned int argc, GMLType* argv, GMLType* out) {
         unsigned int curLength = 0;
         for (const char* pC = argv[0].sVal.c_str(); (*pC) != '\0'; pC++) {
             const char c = *pC;
-            if (c == '#' && (pC == argv[0].sVal || *(pC - 1) != '\\')) {
+            if (c == '#' && (pC == argv[0].sVal.c_str() || *(pC - 1) != '\\')) {
                 if (curLength > longestLine) longestLine = curLength;
                 curLength = 0;
                 continue;
@@ -1456,7 +1457,7 @@ bool Runtime::string_height(unsigned int argc, GMLType* argv, GMLType* out) {
         unsigned int lines = 1;
         for (const char* pC = argv[0].sVal.c_str(); (*pC) != '\0'; pC++) {
             const char c = *pC;
-            if (c == '#' && (pC == argv[0].sVal || *(pC - 1) != '\\')) {
+            if (c == '#' && (pC == argv[0].sVal.c_str() || *(pC - 1) != '\\')) {
                 lines++;
                 continue;
             }
@@ -1504,3 +1505,66 @@ bool Runtime::unimplemented(unsigned int argc, GMLType* argv, GMLType* out) {
     }
     return false;
 }
+
+// These must give exactly what the full functions above give for a real argument
+Runtime::RealFunction Runtime::GetRealFunction(CRInternalFunction function) {
+    switch (function) {
+        case ABS:
+            return [](double x) -> double { return ::abs(x); };
+        case ARCCOS:
+            return [](double x) -> double { return ::acos(x); };
+        case ARCSIN:
+            return [](double x) -> double { return ::asin(x); };
+        case ARCTAN:
+            return [](double x) -> double { return ::atan(x); };
+        case CEIL:
+            return [](double x) -> double { return ::ceil(x); };
+        case COS:
+            return [](double x) -> double { return ::cos(x); };
+        case DEGTORAD:
+            return [](double x) -> double { return (GML_PI * x) / 180.0; };
+        case FLOOR:
+            return [](double x) -> double { return ::floor(x); };
+        case LN:
+            return [](double x) -> double { return ::log(x); };
+        case LOG10:
+            return [](double x) -> double { return ::log10(x); };
+        case LOG2:
+            return [](double x) -> double { return ::log2(x); };
+        case RADTODEG:
+            return [](double x) -> double { return (180.0 * x) / GML_PI; };
+        case ROUND:
+            return [](double x) -> double { return _round(x); };
+        case SIGN:
+            return [](double x) -> double { return (x == 0 ? 0 : (x < 0 ? -1 : 1)); };
+        case SIN:
+            return [](double x) -> double { return ::sin(x); };
+        case SQR:
+            return [](double x) -> double { return x * x; };
+        case TAN:
+            return [](double x) -> double { return ::tan(x); };
+        default:
+            // sqrt isn't here, because it fails on negative numbers
+            return nullptr;
+    }
+}
+
+int Runtime::GetPureArgCount(CRInternalFunction function) {
+    if (GetRealFunction(function)) return 1;
+    switch (function) {
+        case SQRT:
+            return 1;
+        case LENGTHDIR_X:
+        case LENGTHDIR_Y:
+        case POWER:
+            return 2;
+        case MAKE_COLOR_HSV:
+        case MAKE_COLOR_RGB:
+            return 3;
+        case POINT_DIRECTION:
+        case POINT_DISTANCE:
+            return 4;
+        default:
+            return -1;
+    }
+}
@@ -26,7 +26,7 @@ void rotateAround(double* pX, double* pY, double cX, double cY, double s, double
 }
 
 void RefreshInstanceBbox(Instance* i) {
-    if (i->bboxIsStale) {
+    if (i->bboxIsStale()) {
         int spriteIndex = i->mask_index;
         if (spriteIndex == -1) spriteIndex = i->sprite_index;
         if (spriteIndex == -1) {
@@ -37,10 +37,10 @@ void RefreshInstanceBbox(Instance* i) {
         }
         else {
             Sprite* s = AssetManager::GetSprite(spriteIndex);
-            CollisionMap* map = (s->separateCollision ? (s->collisionMaps + (( int )(i->image_index) % s->frameCount)) : s->collisionMaps);
+            CollisionMap* map = (s->separateCollision ? (s->collisionMaps + (( int )(i->image_index()) % s->frameCount)) : s->collisionMaps);
 
-            double tlX = (i->x - (s->originX * i->image_xscale)) + (static_cast<int>(map->left) * i->image_xscale);
-            double tlY = (i->y - (s->originY * i->image_yscale)) + (static_cast<int>(map->top) * i->image_yscale);
+            double tlX = (i->x() - (s->originX * i->image_xscale)) + (static_cast<int>(map->left) * i->image_xscale);
+            double tlY = (i->y() - (s->originY * i->image_yscale)) + (static_cast<int>(map->top) * i->image_yscale);
             double brX = tlX + ((static_cast<int>(map->right) + 1 - static_cast<int>(map->left)) * i->image_xscale) - 1;
             double brY = tlY + ((static_cast<int>(map->bottom) + 1 - static_cast<int>(map->top)) * i->image_yscale) - 1;
 
@@ -67,10 +67,10 @@ void RefreshInstanceBbox(Instance* i) {
                 double s = sin(angle);
                 double c = cos(angle);
 
-                rotateAround(&tlX, &tlY, i->x, i->y, s, c);
-                rotateAround(&trX, &trY, i->x, i->y, s, c);
-                rotateAround(&blX, &blY, i->x, i->y, s, c);
-                rotateAround(&brX, &brY, i->x, i->y, s, c);
+                rotateAround(&tlX, &tlY, i->x(), i->y(), s, c);
+                rotateAround(&trX, &trY, i->x(), i->y(), s, c);
+                rotateAround(&blX, &blY, i->x(), i->y(), s, c);
+                rotateAround(&brX, &brY, i->x(), i->y(), s, c);
 
                 i->bbox_left = dRound(fmin(tlX, fmin(trX, fmin(blX, brX))));
                 i->bbox_right = dRound(fmax(tlX, fmax(trX, fmax(blX, brX))));
@@ -85,7 +85,7 @@ void RefreshInstanceBbox(Instance* i) {
             }
         }
 
-        i->bboxIsStale = false;
+        i->bboxIsStale() = false;
     }
 }
 
@@ -107,18 +107,18 @@ bool CollisionCheck(Instance* i1, Instance* i2) {
     if(spriteIndex < 0) return false;
     Sprite* spr1 = AssetManager::GetSprite(spriteIndex);
     if(!spr1->exists) return false;
-    CollisionMap* map1 = (spr1->separateCollision ? (spr1->collisionMaps + (static_cast<int>(i1->image_index) % spr1->frameCount)) : spr1->collisionMaps);
+    CollisionMap* map1 = (spr1->separateCollision ? (spr1->collisionMaps + (static_cast<int>(i1->image_index()) % spr1->frameCount)) : spr1->collisionMaps);
     spriteIndex = i2->mask_index;
     if (spriteIndex == -1) spriteIndex = i2->sprite_index;
     if (spriteIndex < 0) return false;
     Sprite* spr2 = AssetManager::GetSprite(spriteIndex);
     if(!spr2->exists) return false;
-    CollisionMap* map2 = (spr2->separateCollision ? (spr2->collisionMaps + (static_cast<int>(i2->image_index) % spr2->frameCount)) : spr2->collisionMaps);
+    CollisionMap* map2 = (spr2->separateCollision ? (spr2->collisionMaps + (static_cast<int>(i2->image_index()) % spr2->frameCount)) : spr2->collisionMaps);
 
-    int x1 = dRound(i1->x);
-    int y1 = dRound(i1->y);
-    int x2 = dRound(i2->x);
-    int y2 = dRound(i2->y);
+    int x1 = dRound(i1->x());
+    int y1 = dRound(i1->y());
+    int x2 = dRound(i2->x());
+    int y2 = dRound(i2->y());
 
     double a1 = i1->image_angle * PI / 180.0;
     double a2 = i2->image_angle * PI / 180.0;
@@ -171,7 +171,7 @@ bool CollisionPointCheck(Instance* i1, int x, int y) {
     if (spriteIndex < 0) return false;
     Sprite* spr1 = AssetManager::GetSprite(spriteIndex);
     if (!spr1->exists) return false;
-    CollisionMap* map1 = (spr1->separateCollision ? (spr1->collisionMaps + (static_cast<int>(i1->image_index) % spr1->frameCount)) : spr1->collisionMaps);
+    CollisionMap* map1 = (spr1->separateCollision ? (spr1->collisionMaps + (static_cast<int>(i1->image_index()) % spr1->frameCount)) : spr1->collisionMaps);
     double a1 = i1->image_angle * PI / 180.0;
     double s1 = sin(a1);
     double c1 = cos(a1);
@@ -179,9 +179,9 @@ bool CollisionPointCheck(Instance* i1, int x, int y) {
 
     double curX = static_cast<double>(x);
     double curY = static_cast<double>(y);
-    rotateAround(&curX, &curY, i1->x, i1->y, s1, c1);
-    curX = spr1->originX + ((curX - i1->x) / i1->image_xscale);
-    curY = spr1->originY + ((curY - i1->y) / i1->image_yscale);
+    rotateAround(&curX, &curY, i1->x(), i1->y(), s1, c1);
+    curX = spr1->originX + ((curX - i1->x()) / i1->image_xscale);
+    curY = spr1->originY + ((curY - i1->y()) / i1->image_yscale);
     int nx = dRound(curX);
     int ny = dRound(curY);
 
@@ -207,7 +207,7 @@ bool CollisionRectangleCheck(Instance* i1, int x1, int y1, int x2, int y2, bool
     if (spriteIndex < 0) return false;
     Sprite* spr1 = AssetManager::GetSprite(spriteIndex);
     if (!spr1->exists) return false;
-    CollisionMap* map1 = (spr1->separateCollision ? (spr1->collisionMaps + (static_cast<int>(i1->image_index) % spr1->frameCount)) : spr1->collisionMaps);
+    CollisionMap* map1 = (spr1->separateCollision ? (spr1->collisionMaps + (static_cast<int>(i1->image_index()) % spr1->frameCount)) : spr1->collisionMaps);
     double a1 = i1->image_angle * PI / 180.0;
     double s1 = sin(a1);
     double c1 = cos(a1);
@@ -222,9 +222,9 @@ bool CollisionRectangleCheck(Instance* i1, int x1, int y1, int x2, int y2, bool
         for (int x = cLeft; x <= cRight; x++) {
             double curX = static_cast<double>(x);
             double curY = static_cast<double>(y);
-            rotateAround(&curX, &curY, dRound(i1->x), dRound(i1->y), s1, c1);
-            curX = spr1->originX + ((curX - dRound(i1->x)) / i1->image_xscale);
-            curY = spr1->originY + ((curY - dRound(i1->y)) / i1->image_yscale);
+            rotateAround(&curX, &curY, dRound(i1->x()), dRound(i1->y()), s1, c1);
+            curX = spr1->originX + ((curX - dRound(i1->x())) / i1->image_xscale);
+            curY = spr1->originY + ((curY - dRound(i1->y())) / i1->image_yscale);
             int nx = static_cast<int>(curX);
             int ny = static_cast<int>(curY);
             if (nx >= static_cast<int>(map1->left) && nx <= static_cast<int>(map1->right) && ny >= static_cast<int>(map1->top) && ny <= static_cast<int>(map1->bottom)) {
@@ -0,0 +1,721 @@
+#include "Bytecode.hpp"
+#include "CRRuntime.hpp"
+#include "Compiled.hpp"
+#include "Constants.hpp"
+#include <cmath>
+
+unsigned int CRCodeBuilder::Constant(const GMLType& value) {
+    _out->constants.push_back(value);
+    return static_cast<unsigned int>(_out->constants.size() - 1);
+}
+
+void CRCodeBuilder::Error(const char* message) {
+    GMLType m;
+    m.state = GMLTypeState::String;
+    m.sVal = message;
+    Emit(OP_ERROR, Constant(m));
+}
+
+void CRCodeBuilder::BeginLoop() {
+    _targets.push_back(Target());
+    _targets.back().loop = true;
+}
+
+void CRCodeBuilder::BeginSwitch() {
+    _targets.push_back(Target());
+    _targets.back().loop = false;
+}
+
+void CRCodeBuilder::Break() {
+    if (_targets.empty()) {
+        Emit(OP_EXIT);
+        return;
+    }
+    _targets.back().breaks.push_back(Emit(OP_JUMP, 0));
+}
+
+void CRCodeBuilder::Continue() {
+    for (auto t = _targets.rbegin(); t != _targets.rend(); t++) {
+        if (t->loop) {
+            t->continues.push_back(Emit(OP_JUMP, 0));
+            return;
+        }
+    }
+    Emit(OP_EXIT);
+}
+
+void CRCodeBuilder::EndLoop(unsigned int continueTarget, unsigned int breakTarget) {
+    for (unsigned int operand : _targets.back().continues) Patch(operand, continueTarget);
+    EndSwitch(breakTarget);
+}
+
+void CRCodeBuilder::EndSwitch(unsigned int breakTarget) {
+    for (unsigned int operand : _targets.back().breaks) Patch(operand, breakTarget);
+    _targets.pop_back();
+}
+
+bool GM8Emulator::Compiler::Lower(CRActionList& actions, CRBytecode* output) {
+    CRCodeBuilder b(output);
+    if (!actions.Emit(b)) return false;
+    b.Emit(OP_END);
+    return true;
+}
+
+bool GM8Emulator::Compiler::Lower(CRExpression& expression, CRBytecode* output) {
+    // The result is left in register 0
+    CRCodeBuilder b(output);
+    if (!expression.Emit(b, 0)) return false;
+    b.Emit(OP_END);
+    return true;
+}
+
+
+bool CRActionList::Emit(CRCodeBuilder& b, std::vector<unsigned int>* starts) {
+    for (CRAction* action : _actions) {
+        if (starts) starts->push_back(b.Here());
+        if (!action->Emit(b)) return false;
+    }
+    return true;
+}
+
+void CRActionList::Finalize() {
+    for (CRAction* action : _actions) {
+        action->Finalize();
+        delete action;
+    }
+}
+
+// Applies a binary operator to two constants, the same way the runtime would. Returns false if it can't be done ahead of time, either
+// because the runtime would fail or because the result depends on a quirk that isn't worth copying (such as comparing a real to a string).
+bool _foldOperator(GMLType* lhs, CROperator op, const GMLType& rhs) {
+    if (lhs->state == GMLTypeState::String || rhs.state == GMLTypeState::String) {
+        if (lhs->state != rhs.state) return false;
+        switch (op) {
+            case OPERATOR_ADD:
+                lhs->sVal += rhs.sVal;
+                return true;
+            case OPERATOR_EQUALS:
+                lhs->dVal = (lhs->sVal.compare(rhs.sVal) ? GMLFalse : GMLTrue);
+                break;
+            case OPERATOR_NOT_EQUAL:
+                lhs->dVal = (lhs->sVal.compare(rhs.sVal) ? GMLTrue : GMLFalse);
+                break;
+            case OPERATOR_LT:
+                lhs->dVal = (lhs->sVal.length() < rhs.sVal.length() ? GMLTrue : GMLFalse);
+                break;
+            case OPERATOR_LTE:
+                lhs->dVal = (lhs->sVal.length() <= rhs.sVal.length() ? GMLTrue : GMLFalse);
+                break;
+            case OPERATOR_GT:
+                lhs->dVal = (lhs->sVal.length() > rhs.sVal.length() ? GMLTrue : GMLFalse);
+                break;
+            case OPERATOR_GTE:
+                lhs->dVal = (lhs->sVal.length() >= rhs.sVal.length() ? GMLTrue : GMLFalse);
+                break;
+            default:
+                return false;
+        }
+        lhs->state = GMLTypeState::Double;
+        lhs->sVal.clear();
+        return true;
+    }
+
+    double& l = lhs->dVal;
+    double r = rhs.dVal;
+    switch (op) {
+        case OPERATOR_ADD:
+            l += r;
+            break;
+        case OPERATOR_SUBTRACT:
+            l -= r;
+            break;
+        case OPERATOR_MULTIPLY:
+            l *= r;
+            break;
+        case OPERATOR_DIVIDE:
+            l /= r;
+            break;
+        case OPERATOR_EQUALS:
+            l = (Runtime::_equal(l, r) ? GMLTrue : GMLFalse);
+            break;
+        case OPERATOR_NOT_EQUAL:
+            l = (Runtime::_equal(l, r) ? GMLFalse : GMLTrue);
+            break;
+        case OPERATOR_LT:
+            l = (l < r ? GMLTrue : GMLFalse);
+            break;
+        case OPERATOR_LTE:
+            l = ((l < r || Runtime::_equal(l, r)) ? GMLTrue : GMLFalse);
+            break;
+        case OPERATOR_GT:
+            l = (l > r ? GMLTrue : GMLFalse);
+            break;
+        case OPERATOR_GTE:
+            l = ((l > r || Runtime::_equal(l, r)) ? GMLTrue : GMLFalse);
+            break;
+        case OPERATOR_BOOLEAN_AND:
+            l = (Runtime::_isTrue(lhs) && Runtime::_isTrue(&rhs) ? GMLTrue : GMLFalse);
+            break;
+        case OPERATOR_BOOLEAN_OR:
+            l = (Runtime::_isTrue(lhs) || Runtime::_isTrue(&rhs) ? GMLTrue : GMLFalse);
+            break;
+        case OPERATOR_BOOLEAN_XOR:
+            l = (Runtime::_isTrue(lhs) != Runtime::_isTrue(&rhs) ? GMLTrue : GMLFalse);
+            break;
+        case OPERATOR_MOD:
+            l = std::fmod(l, r);
+            break;
+        case OPERATOR_DIV:
+            l = ::floor(l / r);
+            break;
+        case OPERATOR_BITWISE_AND:
+            l = ( double )(Runtime::_round(l) & Runtime::_round(r));
+            break;
+        case OPERATOR_BITWISE_OR:
+            l = ( double )(Runtime::_round(l) | Runtime::_round(r));
+            break;
+        case OPERATOR_BITWISE_XOR:
+            l = ( double )(Runtime::_round(l) ^ Runtime::_round(r));
+            break;
+        default:
+            // Shifts are left to the runtime, as shifting by a negative or too large amount isn't defined
+            return false;
+    }
+    return true;
+}
+
+// Whether applying this operator to a real and this constant always gives back the same real. "+ 0" isn't one, as -0 + 0 is 0.
+bool _isIdentity(CROperator op, const GMLType& rhs) {
+    if (rhs.state != GMLTypeState::Double) return false;
+    switch (op) {
+        case OPERATOR_SUBTRACT:
+            return rhs.dVal == 0.0 && !std::signbit(rhs.dVal);
+        case OPERATOR_MULTIPLY:
+        case OPERATOR_DIVIDE:
+            return rhs.dVal == 1.0;
+        default:
+            return false;
+    }
+}
+
+bool CRExpression::Fold(GMLType* out) {
+    if (!_values.size() || !_values[0]->Fold(out)) return false;
+    for (size_t i = 1; i < _values.size(); i++) {
+        GMLType rhs;
+        if (!_values[i]->Fold(&rhs) || !_foldOperator(out, _values[i - 1]->GetOperator(), rhs)) return false;
+    }
+    return true;
+}
+
+bool CRExpression::Emit(CRCodeBuilder& b, unsigned int dst) {
+    if (!_values.size()) {
+        b.Use(dst);
+        b.Error("Tried to evaluate empty expression");
+        return true;
+    }
+
+    // Values are combined from left to right, so whatever's constant at the start is worked out now instead of every time the code runs
+    size_t i = 1;
+    bool real;
+    GMLType folded;
+    if (_values[0]->Fold(&folded)) {
+        GMLType rhs;
+        while (i < _values.size() && _values[i]->Fold(&rhs) && _foldOperator(&folded, _values[i - 1]->GetOperator(), rhs)) i++;
+        b.Use(dst);
+        b.Emit(OP_LOAD_CONST, dst, b.Constant(folded));
+        real = (folded.state == GMLTypeState::Double);
+    }
+    else {
+        if (!_values[0]->Emit(b, dst)) return false;
+        real = _values[0]->IsReal();
+    }
+
+    for (; i < _values.size(); i++) {
+        CROperator op = _values[i - 1]->GetOperator();
+
+        // Something like "* 1" can be left out, as long as what it's applied to can't be a string, which would be an error
+        GMLType rhs;
+        if (real && _values[i]->Fold(&rhs) && _isIdentity(op, rhs)) continue;
+
+        if (!_values[i]->Emit(b, dst + 1)) return false;
+        switch (op) {
+            case OPERATOR_ADD:
+                b.Emit(OP_ADD, dst, dst + 1);
+                break;
+            case OPERATOR_SUBTRACT:
+                b.Emit(OP_SUBTRACT, dst, dst + 1);
+                break;
+            case OPERATOR_MULTIPLY:
+                b.Emit(OP_MULTIPLY, dst, dst + 1);
+                break;
+            case OPERATOR_DIVIDE:
+                b.Emit(OP_DIVIDE, dst, dst + 1);
+                break;
+            case OPERATOR_EQUALS:
+                b.Emit(OP_EQUALS, dst, dst + 1);
+                break;
+            case OPERATOR_NOT_EQUAL:
+                b.Emit(OP_NOT_EQUAL, dst, dst + 1);
+                break;
+            case OPERATOR_LT:
+                b.Emit(OP_LT, dst, dst + 1);
+                break;
+            case OPERATOR_LTE:
+                b.Emit(OP_LTE, dst, dst + 1);
+                break;
+            case OPERATOR_GT:
+                b.Emit(OP_GT, dst, dst + 1);
+                break;
+            case OPERATOR_GTE:
+                b.Emit(OP_GTE, dst, dst + 1);
+                break;
+            case OPERATOR_BOOLEAN_AND:
+                b.Emit(OP_BOOLEAN_AND, dst, dst + 1);
+                break;
+            case OPERATOR_BOOLEAN_OR:
+                b.Emit(OP_BOOLEAN_OR, dst, dst + 1);
+                break;
+            case OPERATOR_MOD:
+            case OPERATOR_DIV:
+            case OPERATOR_BITWISE_AND:
+            case OPERATOR_BITWISE_OR:
+            case OPERATOR_BITWISE_XOR:
+            case OPERATOR_BOOLEAN_XOR:
+            case OPERATOR_LSHIFT:
+            case OPERATOR_RSHIFT:
+                b.Emit(OP_OPERATOR, dst, dst + 1, op);
+                break;
+            default:
+                b.Error("Unrecognized operator");
+                break;
+        }
+
+        // Every other operator either fails on a string or gives a real. These keep whatever type the left-hand side was.
+        if (op != OPERATOR_ADD && op != OPERATOR_BOOLEAN_AND && op != OPERATOR_BOOLEAN_OR && op != OPERATOR_BOOLEAN_XOR) real = true;
+    }
+    return true;
+}
+
+void CRExpression::Finalize() {
+    for (CRExpressionValue* value : _values) {
+        value->Finalize();
+        delete value;
+    }
+}
+
+bool CRExpressionValue::Fold(GMLType* out) {
+    if (!_constant(out)) return false;
+    for (CRUnaryOperator op : _unary) {
+        // These are all errors on a string, which is left for the runtime to report
+        if (out->state != GMLTypeState::Double) return false;
+        switch (op) {
+            case OPERATOR_NOT:
+                out->dVal = (Runtime::_isTrue(out) ? GMLFalse : GMLTrue);
+                break;
+            case OPERATOR_TILDE:
+                out->dVal = ~Runtime::_round(out->dVal);
+                break;
+            case OPERATOR_NEGATIVE:
+                out->dVal = -out->dVal;
+                break;
+            case OPERATOR_POSITIVE:
+                break;
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+// Unary operators stop the code if they're given anything but a real
+bool CRExpressionValue::IsReal() { return _unary.size() || _isReal(); }
+
+bool CRExpressionValue::Emit(CRCodeBuilder& b, unsigned int dst) {
+    b.Use(dst);
+    if (!this->_emit(b, dst)) return false;
+    for (CRUnaryOperator op : _unary) {
+        switch (op) {
+            case OPERATOR_NOT:
+                b.Emit(OP_NOT, dst);
+                break;
+            case OPERATOR_TILDE:
+                b.Emit(OP_BIT_NOT, dst);
+                break;
+            case OPERATOR_NEGATIVE:
+                b.Emit(OP_NEGATE, dst);
+                break;
+            case OPERATOR_POSITIVE:
+                b.Emit(OP_CHECK_REAL, dst);
+                break;
+            default:
+                b.Error("Unrecognized unary operator");
+                break;
+        }
+    }
+    return true;
+}
+
+
+// Emits code leaving the array index for these dimensions in "reg". "index" is set to the register to pass as the index operand,
+// which is CR_NO_INDEX (meaning index 0) if there are no dimensions.
+bool _emitArrayIndex(CRCodeBuilder& b, std::vector<CRExpression>& dimensions, unsigned int reg, unsigned int* index) {
+    if (!dimensions.size()) {
+        (*index) = CR_NO_INDEX;
+        return true;
+    }
+    (*index) = reg;
+    b.Use(reg);
+    if (dimensions.size() > 2) {
+        b.Error("Tried to access array with more than 2 dimensions; 2-dimensional is the highest supported");
+        return true;
+    }
+
+    if (!dimensions[0].Emit(b, reg)) return false;
+    b.Emit(OP_ARRAY_INDEX, reg);
+    if (dimensions.size() == 2) {
+        if (!dimensions[1].Emit(b, reg + 1)) return false;
+        b.Emit(OP_ARRAY_INDEX, reg + 1);
+        b.Emit(OP_ARRAY_INDEX_2D, reg, reg + 1);
+    }
+    return true;
+}
+
+// Emits the arguments to a function or script into consecutive registers starting at "argv"
+bool _emitArgs(CRCodeBuilder& b, std::vector<CRExpression>& args, unsigned int argv) {
+    b.Use(argv);
+    for (unsigned int i = 0; i < args.size(); i++) {
+        if (!args[i].Emit(b, argv + i)) return false;
+    }
+    return true;
+}
+
+
+bool CRActionBindVars::Emit(CRCodeBuilder&) { return true; }
+
+bool CRActionAssignmentField::Emit(CRCodeBuilder& b) {
+    unsigned int value = b.Base();
+    if (!_expression.Emit(b, value)) return false;
+
+    if (_hasDeref) {
+        if (!_deref.Emit(b, value + 1)) return false;
+        b.Emit(OP_SET_FIELD_OF, _field, _method, value, value + 1, CR_NO_INDEX);
+    }
+    else if (_localSlot != CR_NOT_LOCAL) {
+        b.Emit(OP_SET_LOCAL, _localSlot, _method, value);
+    }
+    else {
+        b.Emit(OP_SET_FIELD, _field, _method, value);
+    }
+    return true;
+}
+
+bool CRActionAssignmentArray::Emit(CRCodeBuilder& b) {
+    unsigned int value = b.Base();
+    if (!_expression.Emit(b, value)) return false;
+
+    unsigned int index;
+    if (!_emitArrayIndex(b, _dimensions, value + 1, &index)) return false;
+
+    if (_hasDeref) {
+        if (!_deref.Emit(b, value + 2)) return false;
+        b.Emit(OP_SET_FIELD_OF, _field, _method, value, value + 2, index);
+    }
+    else if (_localSlot != CR_NOT_LOCAL) {
+        b.Emit(OP_SET_LOCAL_ARRAY, _localSlot, _method, value, index);
+    }
+    else {
+        b.Emit(OP_SET_FIELD_ARRAY, _field, _method, value, index);
+    }
+    return true;
+}
+
+bool CRActionAssignmentInstanceVar::Emit(CRCodeBuilder& b) {
+    unsigned int value = b.Base();
+    if (!_expression.Emit(b, value)) return false;
+
+    unsigned int index;
+    if (!_emitArrayIndex(b, _dimensions, value + 1, &index)) return false;
+
+    if (_hasDeref) {
+        if (!_deref.Emit(b, value + 2)) return false;
+        b.Emit(OP_SET_INSTANCE_VAR_OF, _var, _method, value, value + 2, index);
+    }
+    else {
+        b.Emit(OP_SET_INSTANCE_VAR, _var, _method, value, index);
+    }
+    return true;
+}
+
+bool CRActionAssignmentGameVar::Emit(CRCodeBuilder& b) {
+    unsigned int value = b.Base();
+    if (!_expression.Emit(b, value)) return false;
+
+    unsigned int index;
+    if (!_emitArrayIndex(b, _dimensions, value + 1, &index)) return false;
+    b.Emit(OP_SET_GAME_VAR, _var, _method, value, index);
+    return true;
+}
+
+bool CRActionBlock::Emit(CRCodeBuilder& b) { return _list.Emit(b); }
+
+bool CRActionRunFunction::Emit(CRCodeBuilder& b) {
+    if (_args.size() > 16) {
+        b.Error("Too many arguments to internal function");
+        return true;
+    }
+    if (!_emitArgs(b, _args, b.Base())) return false;
+    b.Emit(OP_CALL_VOID, _function, b.Base(), _args.size());
+    return true;
+}
+
+bool CRActionRunScript::Emit(CRCodeBuilder& b) {
+    if (_args.size() > 16) {
+        b.Error("Too many arguments to script");
+        return true;
+    }
+    if (!_emitArgs(b, _args, b.Base())) return false;
+    b.Emit(OP_SCRIPT_VOID, _scriptID, b.Base(), _args.size());
+    return true;
+}
+
+bool CRActionIfElse::Emit(CRCodeBuilder& b) {
+    // Only the branch that would run is kept if the condition is constant
+    GMLType condition;
+    if (_expression.Fold(&condition)) {
+        if (Runtime::_isTrue(&condition)) return _if->Emit(b);
+        return _else ? _else->Emit(b) : true;
+    }
+
+    if (!_expression.Emit(b, b.Base())) return false;
+    unsigned int skipIf = b.Emit(OP_JUMP_IF_FALSE, b.Base(), 0);
+    if (!_if->Emit(b)) return false;
+    if (_else) {
+        unsigned int skipElse = b.Emit(OP_JUMP, 0);
+        b.Patch(skipIf, b.Here());
+        if (!_else->Emit(b)) return false;
+        b.Patch(skipElse, b.Here());
+    }
+    else {
+        b.Patch(skipIf, b.Here());
+    }
+    return true;
+}
+
+bool CRActionWith::Emit(CRCodeBuilder& b) {
+    if (!_expression.Emit(b, b.Base())) return false;
+    unsigned int begin = b.Emit(OP_WITH_BEGIN, b.Base(), 0);
+
+    b.BeginLoop();
+    unsigned int top = b.Here();
+    if (!_code->Emit(b)) return false;
+    unsigned int next = b.Here();
+    b.Emit(OP_WITH_NEXT, top);
+    unsigned int end = b.Here();
+    b.Emit(OP_WITH_END);
+    b.Patch(begin, b.Here());
+    b.EndLoop(next, end);
+    return true;
+}
+
+bool CRActionRepeat::Emit(CRCodeBuilder& b) {
+    // The counter stays in the base register for the whole loop, so the body gets the registers above it
+    unsigned int counter = b.Base();
+    if (!_expression.Emit(b, counter)) return false;
+    b.Emit(OP_REPEAT_BEGIN, counter);
+    b.Reserve(1);
+
+    b.BeginLoop();
+    unsigned int check = b.Emit(OP_JUMP, 0);
+    unsigned int top = b.Here();
+    if (!_code->Emit(b)) return false;
+    unsigned int step = b.Here();
+    b.Patch(check, step);
+    b.Emit(OP_REPEAT_STEP, counter, top);
+    b.EndLoop(step, b.Here());
+
+    b.Release(1);
+    return true;
+}
+
+bool CRActionWhile::Emit(CRCodeBuilder& b) {
+    // Loops are laid out with the condition at the bottom, so each iteration only takes one jump
+    b.BeginLoop();
+    unsigned int check = b.Emit(OP_JUMP, 0);
+    unsigned int top = b.Here();
+    if (!_code->Emit(b)) return false;
+    unsigned int condition = b.Here();
+    b.Patch(check, condition);
+    if (!_expression.Emit(b, b.Base())) return false;
+    b.Emit(OP_JUMP_IF_TRUE, b.Base(), top);
+    b.EndLoop(condition, b.Here());
+    return true;
+}
+
+bool CRActionDoUntil::Emit(CRCodeBuilder& b) {
+    b.BeginLoop();
+    unsigned int top = b.Here();
+    if (!_code->Emit(b)) return false;
+    unsigned int condition = b.Here();
+    if (!_expression.Emit(b, b.Base())) return false;
+    b.Emit(OP_JUMP_IF_FALSE, b.Base(), top);
+    b.EndLoop(condition, b.Here());
+    return true;
+}
+
+bool CRActionFor::Emit(CRCodeBuilder& b) {
+    if (!_initializer->Emit(b)) return false;
+
+    b.BeginLoop();
+    unsigned int check = b.Emit(OP_JUMP, 0);
+    unsigned int top = b.Here();
+    if (!_code->Emit(b)) return false;
+    unsigned int finalizer = b.Here();
+    if (!_finalizer->Emit(b)) return false;
+    b.Patch(check, b.Here());
+    if (!_check.Emit(b, b.Base())) return false;
+    b.Emit(OP_JUMP_IF_TRUE, b.Base(), top);
+    b.EndLoop(finalizer, b.Here());
+    return true;
+}
+
+bool CRActionSwitch::Emit(CRCodeBuilder& b) {
+    unsigned int value = b.Base();
+    if (!_expression.Emit(b, value)) return false;
+
+    std::vector<unsigned int> caseJumps;
+    for (SwitchCase& c : _cases) {
+        if (!c.expression.Emit(b, value + 1)) return false;
+        caseJumps.push_back(b.Emit(OP_JUMP_IF_CASE, value, value + 1, 0));
+    }
+    unsigned int defaultJump = b.Emit(OP_JUMP, 0);
+
+    b.BeginSwitch();
+    std::vector<unsigned int> starts;
+    if (!_actions.Emit(b, &starts)) return false;
+    unsigned int end = b.Here();
+    starts.push_back(end);
+
+    for (size_t i = 0; i < _cases.size(); i++) {
+        b.Patch(caseJumps[i], _cases[i].offset < starts.size() ? starts[_cases[i].offset] : end);
+    }
+    b.Patch(defaultJump, _defaultOffset < starts.size() ? starts[_defaultOffset] : end);
+    b.EndSwitch(end);
+    return true;
+}
+
+bool CRActionBreak::Emit(CRCodeBuilder& b) {
+    b.Break();
+    return true;
+}
+
+bool CRActionContinue::Emit(CRCodeBuilder& b) {
+    b.Continue();
+    return true;
+}
+
+bool CRActionExit::Emit(CRCodeBuilder& b) {
+    b.Emit(OP_EXIT);
+    return true;
+}
+
+bool CRActionReturn::Emit(CRCodeBuilder& b) {
+    if (!_expression.Emit(b, b.Base())) return false;
+    b.Emit(OP_RETURN, b.Base());
+    return true;
+}
+
+bool CRExpLiteral::_emit(CRCodeBuilder& b, unsigned int dst) {
+    b.Emit(OP_LOAD_CONST, dst, b.Constant(_value));
+    return true;
+}
+
+bool CRExpFunction::_emit(CRCodeBuilder& b, unsigned int dst) {
+    if (_args.size() > 16) {
+        b.Error("Too many arguments to internal function");
+        return true;
+    }
+    if (!_emitArgs(b, _args, dst + 1)) return false;
+    if (_args.size() == 1 && Runtime::GetRealFunction(_function)) {
+        b.Emit(OP_CALL_REAL, dst, _function, dst + 1);
+    }
+    else {
+        b.Emit(OP_CALL, dst, _function, dst + 1, _args.size());
+    }
+    return true;
+}
+
+bool CRExpFunction::_constant(GMLType* out) {
+    if (Runtime::GetPureArgCount(_function) != static_cast<int>(_args.size())) return false;
+    GMLType argv[4];
+    for (size_t i = 0; i < _args.size(); i++) {
+        if (!_args[i].Fold(&argv[i])) return false;
+    }
+    return Runtime::FoldFunction(_function, static_cast<unsigned int>(_args.size()), argv, out);
+}
+
+// A pure function gives a real even if it fails, since the result is set to 0 before it's called
+bool CRExpFunction::_isReal() { return Runtime::GetPureArgCount(_function) >= 0; }
+
+bool CRExpScript::_emit(CRCodeBuilder& b, unsigned int dst) {
+    if (_args.size() > 16) {
+        b.Error("Too many arguments to script");
+        return true;
+    }
+    if (!_emitArgs(b, _args, dst + 1)) return false;
+    b.Emit(OP_SCRIPT, dst, _script, dst + 1, _args.size());
+    return true;
+}
+
+bool CRExpNestedExpression::_emit(CRCodeBuilder& b, unsigned int dst) { return _expression.Emit(b, dst); }
+
+bool CRExpField::_emit(CRCodeBuilder& b, unsigned int dst) {
+    if (_hasDeref) {
+        if (!_deref.Emit(b, dst)) return false;
+        b.Emit(OP_GET_FIELD_OF, dst, _fieldNumber, dst, CR_NO_INDEX);
+    }
+    else if (_localSlot != CR_NOT_LOCAL) {
+        b.Emit(OP_GET_LOCAL, dst, _localSlot);
+    }
+    else {
+        b.Emit(OP_GET_FIELD, dst, _fieldNumber);
+    }
+    return true;
+}
+
+bool CRExpArray::_emit(CRCodeBuilder& b, unsigned int dst) {
+    unsigned int index;
+    if (!_emitArrayIndex(b, _dimensions, dst, &index)) return false;
+
+    if (_hasDeref) {
+        if (!_deref.Emit(b, dst + 1)) return false;
+        b.Emit(OP_GET_FIELD_OF, dst, _fieldNumber, dst + 1, index);
+    }
+    else if (_localSlot != CR_NOT_LOCAL) {
+        b.Emit(OP_GET_LOCAL_ARRAY, dst, _localSlot, index);
+    }
+    else {
+        b.Emit(OP_GET_FIELD_ARRAY, dst, _fieldNumber, index);
+    }
+    return true;
+}
+
+bool CRExpInstanceVar::_emit(CRCodeBuilder& b, unsigned int dst) {
+    unsigned int index;
+    if (!_emitArrayIndex(b, _dimensions, dst, &index)) return false;
+
+    if (_hasDeref) {
+        if (!_deref.Emit(b, dst + 1)) return false;
+        b.Emit(OP_GET_INSTANCE_VAR_OF, dst, _var, dst + 1, index);
+    }
+    else {
+        b.Emit(OP_GET_INSTANCE_VAR, dst, _var, index);
+    }
+    return true;
+}
+
+bool CRExpGameVar::_emit(CRCodeBuilder& b, unsigned int dst) {
+    unsigned int index;
+    if (!_emitArrayIndex(b, _dimensions, dst, &index)) return false;
+    b.Emit(OP_GET_GAME_VAR, dst, _var, index);
+    return true;
+}
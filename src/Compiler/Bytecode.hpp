@@ -0,0 +1,139 @@
+#pragma once
+
+#include "CREnums.hpp"
+#include "CRGMLType.hpp"
+#include <vector>
+
+class CRActionList;
+class CRExpression;
+
+// Opcodes for compiled GML. Every instruction is an opcode word followed by its operands, one word each.
+// "r" operands are registers in the running code's frame, "k" operands index its constant table, and "target" operands are positions in its code.
+// An index operand of CR_NO_INDEX means the variable isn't being used as an array, so index 0 is used.
+#define CR_OPCODES(X)                                                                            \
+    X(OP_END)                      /* */                                                         \
+    X(OP_EXIT)                     /* */                                                         \
+    X(OP_RETURN)                   /* r */                                                       \
+    X(OP_ERROR)                    /* k - message */                                             \
+    X(OP_LOAD_CONST)               /* r k */                                                     \
+    X(OP_NOT)                      /* r */                                                       \
+    X(OP_BIT_NOT)                  /* r */                                                       \
+    X(OP_NEGATE)                   /* r */                                                       \
+    X(OP_CHECK_REAL)               /* r */                                                       \
+    X(OP_ADD)                      /* r r - the result goes in the first one */                  \
+    X(OP_SUBTRACT)                 /* r r */                                                     \
+    X(OP_MULTIPLY)                 /* r r */                                                     \
+    X(OP_DIVIDE)                   /* r r */                                                     \
+    X(OP_EQUALS)                   /* r r */                                                     \
+    X(OP_NOT_EQUAL)                /* r r */                                                     \
+    X(OP_LT)                       /* r r */                                                     \
+    X(OP_LTE)                      /* r r */                                                     \
+    X(OP_GT)                       /* r r */                                                     \
+    X(OP_GTE)                      /* r r */                                                     \
+    X(OP_BOOLEAN_AND)              /* r r */                                                     \
+    X(OP_BOOLEAN_OR)               /* r r */                                                     \
+    X(OP_OPERATOR)                 /* r r operator - for the less common CROperators */          \
+    X(OP_ARRAY_INDEX)              /* r - turns an array accessor into an index */               \
+    X(OP_ARRAY_INDEX_2D)           /* r r - combines two indices into the first */               \
+    X(OP_GET_FIELD)                /* r field */                                                 \
+    X(OP_GET_FIELD_ARRAY)          /* r field index */                                           \
+    X(OP_GET_LOCAL)                /* r slot */                                                  \
+    X(OP_GET_LOCAL_ARRAY)          /* r slot index */                                            \
+    X(OP_GET_FIELD_OF)             /* r field deref index */                                     \
+    X(OP_GET_INSTANCE_VAR)         /* r var index */                                             \
+    X(OP_GET_INSTANCE_VAR_OF)      /* r var deref index */                                       \
+    X(OP_GET_GAME_VAR)             /* r var index */                                             \
+    X(OP_SET_FIELD)                /* field method value */                                      \
+    X(OP_SET_FIELD_ARRAY)          /* field method value index */                                \
+    X(OP_SET_LOCAL)                /* slot method value */                                       \
+    X(OP_SET_LOCAL_ARRAY)          /* slot method value index */                                 \
+    X(OP_SET_FIELD_OF)             /* field method value deref index */                          \
+    X(OP_SET_INSTANCE_VAR)         /* var method value index */                                  \
+    X(OP_SET_INSTANCE_VAR_OF)      /* var method value deref index */                            \
+    X(OP_SET_GAME_VAR)             /* var method value index */                                  \
+    X(OP_CALL)                     /* r function argv argc - argv is the first argument register */ \
+    X(OP_CALL_VOID)                /* function argv argc */                                      \
+    X(OP_CALL_REAL)                /* r function argv - one argument, with a fast path for reals */ \
+    X(OP_SCRIPT)                   /* r script argv argc */                                      \
+    X(OP_SCRIPT_VOID)              /* script argv argc */                                        \
+    X(OP_JUMP)                     /* target */                                                  \
+    X(OP_JUMP_IF_FALSE)            /* r target */                                                \
+    X(OP_JUMP_IF_TRUE)             /* r target */                                                \
+    X(OP_JUMP_IF_CASE)             /* r r target - jumps if the switch value matches the case */ \
+    X(OP_REPEAT_BEGIN)             /* r - turns a repeat count into a counter */                 \
+    X(OP_REPEAT_STEP)              /* r target - jumps while the counter hasn't run out */       \
+    X(OP_WITH_BEGIN)               /* r target - jumps past OP_WITH_END if there's nothing to run as */ \
+    X(OP_WITH_NEXT)                /* target - jumps if there's another instance to run as */    \
+    X(OP_WITH_END)                 /* */
+
+enum CROpcode {
+#define CR_OPCODE_ENUM(op) op,
+    CR_OPCODES(CR_OPCODE_ENUM)
+#undef CR_OPCODE_ENUM
+};
+
+constexpr unsigned int CR_NO_INDEX = 0xFFFFFFFF;
+
+// Compiled GML, ready to be run by the runtime
+struct CRBytecode {
+    std::vector<unsigned int> code;
+    std::vector<GMLType> constants;
+    unsigned int registerCount = 0;
+    std::vector<unsigned int> localFields;  // The field number of each var local, by frame slot
+};
+
+// Used by the parse tree in Compiled.hpp to lower itself to bytecode
+class CRCodeBuilder {
+  private:
+    // Somewhere break or continue can jump to. Switches only take breaks.
+    struct Target {
+        bool loop;
+        std::vector<unsigned int> breaks;
+        std::vector<unsigned int> continues;
+    };
+
+    CRBytecode* _out;
+    std::vector<Target> _targets;
+    unsigned int _base;
+
+  public:
+    CRCodeBuilder(CRBytecode* out) : _out(out), _base(0) {}
+
+    // Appends an instruction. Returns the position of its last operand, so that jump targets can be patched in later.
+    template <typename... Operands>
+    unsigned int Emit(CROpcode op, Operands... operands) {
+        _out->code.push_back(op);
+        (_out->code.push_back(static_cast<unsigned int>(operands)), ...);
+        return static_cast<unsigned int>(_out->code.size() - 1);
+    }
+    inline unsigned int Here() const { return static_cast<unsigned int>(_out->code.size()); }
+    inline void Patch(unsigned int operand, unsigned int target) { _out->code[operand] = target; }
+
+    unsigned int Constant(const GMLType& value);
+    void Error(const char* message);
+
+    // Registers from Base() up are free for the statement being emitted. Expressions are given a register to put their result in,
+    // and may use any register above that.
+    inline unsigned int Base() const { return _base; }
+    inline void Reserve(unsigned int count) { _base += count; }
+    inline void Release(unsigned int count) { _base -= count; }
+    inline void Use(unsigned int reg) {
+        if (reg >= _out->registerCount) _out->registerCount = reg + 1;
+    }
+
+    // Loops and switches. Break() and Continue() jump to the targets later given to EndLoop() or EndSwitch(), or end the code if they're outside of any.
+    void BeginLoop();
+    void BeginSwitch();
+    void Break();
+    void Continue();
+    void EndLoop(unsigned int continueTarget, unsigned int breakTarget);
+    void EndSwitch(unsigned int breakTarget);
+};
+
+namespace GM8Emulator {
+    namespace Compiler {
+        // Lowers parsed code to bytecode. Returns true on success, false on error.
+        bool Lower(CRActionList& actions, CRBytecode* output);
+        bool Lower(CRExpression& expression, CRBytecode* output);
+    };
+};
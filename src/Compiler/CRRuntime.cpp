@@ -1,8 +1,9 @@
 #include "CRRuntime.hpp"
+#include "AlarmManager.hpp"
 #include "AssetManager.hpp"
+#include "Bytecode.hpp"
 #include "CodeRunner.hpp"
 #include "Collision.hpp"
-#include "Compiled.hpp"
 #include "Constants.hpp"
 #include "GlobalValues.hpp"
 #include "Instance.hpp"
@@ -10,18 +11,22 @@
 #include "Renderer.hpp"
 
 #include <chrono>
+#include <deque>
 #include <math.h>
 #include <stdarg.h>
 
 GlobalValues* _globalValues;
-std::map<unsigned int, std::map<unsigned int, GMLType>> _global;
+std::map<unsigned int, GMLArray> _global;
 std::map<CRInstanceVar, std::map<unsigned int, GMLType>> _globalInstance;
 std::vector<bool (*)(unsigned int, GMLType*, GMLType*)> _gmlFuncs;
+std::vector<Runtime::RealFunction> _realFuncs;
 std::string _error;
 
 void Runtime::Init(GlobalValues* globals, std::vector<bool (*)(unsigned int, GMLType*, GMLType*)>& gmlFuncs) {
     _globalValues = globals;
     _gmlFuncs = gmlFuncs;
+    _realFuncs.clear();
+    for (unsigned int f = 0; f < _gmlFuncs.size(); f++) _realFuncs.push_back(GetRealFunction(static_cast<CRInternalFunction>(f)));
 }
 
 void Runtime::Finalize() {}
@@ -29,8 +34,41 @@ void Runtime::Finalize() {}
 GlobalValues* Runtime::GetGlobals() { return _globalValues; }
 
 
-Runtime::Context _context;
-Runtime::Context& Runtime::GetContext() { return _context; }
+// A frame for each piece of code that's running, innermost last, with the bottom one there for when nothing is. Frames are kept once
+// they've been made, so entering code only fills one in, and being in a deque they never move while code deeper down is running.
+std::deque<Runtime::Context> _frames(1);
+unsigned int _frameDepth = 0;
+Runtime::Context* _context = &_frames[0];
+Runtime::Context& Runtime::GetContext() { return *_context; }
+
+// Var locals for every frame, each frame's slots following on from the one below it
+std::vector<GMLArray> _localArena;
+
+void _pushFrame(const CRBytecode& code, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, unsigned int argc, const GMLType* argv) {
+    unsigned int localBase = _context->localBase + (_context->code ? static_cast<unsigned int>(_context->code->localFields.size()) : 0);
+    if (_localArena.size() < localBase + code.localFields.size()) _localArena.resize(localBase + code.localFields.size());
+    _frameDepth++;
+    if (_frameDepth == _frames.size()) _frames.emplace_back();
+    _context = &_frames[_frameDepth];
+    _context->self = self;
+    _context->other = other;
+    _context->eventId = ev;
+    _context->eventNumber = sub;
+    _context->objId = asObjId;
+    _context->argc = argc;
+    _context->argv = argv;
+    _context->code = &code;
+    _context->localBase = localBase;
+}
+
+void _popFrame() {
+    // Locals don't outlive the code that made them
+    for (size_t i = 0; i < _context->code->localFields.size(); i++) _localArena[_context->localBase + i].Clear();
+    _context->undeclaredLocals.clear();
+    _context->localInstance.clear();
+    _frameDepth--;
+    _context = &_frames[_frameDepth];
+}
 
 GMLType returnBuffer;
 Runtime::ReturnCause _cause;
@@ -70,35 +108,6 @@ bool Runtime::_assertArgs(unsigned int& argc, GMLType* argv, unsigned int arge,
     return true;
 }
 
-bool CRExpressionValue::Evaluate(GMLType* output) {
-    if (!this->_evaluate(output)) return false;
-    for (CRUnaryOperator op : _unary) {
-        if (output->state == GMLTypeState::String) {
-            _cause = Runtime::ReturnCause::ExitError;
-            //_error = "Tried to apply unary operator " + std::to_string(op) + " to string \"" + output->sVal + "\"";
-            return false;
-        }
-        switch (op) {
-            case OPERATOR_NOT:
-                output->dVal = (Runtime::_isTrue(output) ? GMLFalse : GMLTrue);
-                break;
-            case OPERATOR_TILDE:
-                output->dVal = ~Runtime::_round(output->dVal);
-                break;
-            case OPERATOR_NEGATIVE:
-                output->dVal = -output->dVal;
-                break;
-            case OPERATOR_POSITIVE:
-                break;
-            default:
-                _cause = Runtime::ReturnCause::ExitError;
-                //_error = "Unrecognized unary operator " + std::to_string(op);
-                return false;
-        }
-    }
-    return true;
-}
-
 
 bool _applySetMethod(GMLType* lhs, CRSetMethod method, const GMLType* const rhs) {
     if (method == SM_ASSIGN) {
@@ -161,88 +170,88 @@ bool _getGameValue(CRGameVar index, unsigned int arrayIndex, GMLType* out) {
     out->state = GMLTypeState::Double;
     switch (index) {
         case ARGUMENT:
-            if (_context.argc > arrayIndex) {
-                (*out) = _context.argv[arrayIndex];
+            if (_context->argc > arrayIndex) {
+                (*out) = _context->argv[arrayIndex];
             }
             break;
         case ARGUMENT0:
-            if (_context.argc > 0) {
-                (*out) = _context.argv[0];
+            if (_context->argc > 0) {
+                (*out) = _context->argv[0];
             }
             break;
         case ARGUMENT1:
-            if (_context.argc > 1) {
-                (*out) = _context.argv[1];
+            if (_context->argc > 1) {
+                (*out) = _context->argv[1];
             }
             break;
         case ARGUMENT2:
-            if (_context.argc > 2) {
-                (*out) = _context.argv[2];
+            if (_context->argc > 2) {
+                (*out) = _context->argv[2];
             }
             break;
         case ARGUMENT3:
-            if (_context.argc > 3) {
-                (*out) = _context.argv[3];
+            if (_context->argc > 3) {
+                (*out) = _context->argv[3];
             }
             break;
         case ARGUMENT4:
-            if (_context.argc > 4) {
-                (*out) = _context.argv[4];
+            if (_context->argc > 4) {
+                (*out) = _context->argv[4];
             }
             break;
         case ARGUMENT5:
-            if (_context.argc > 5) {
-                (*out) = _context.argv[5];
+            if (_context->argc > 5) {
+                (*out) = _context->argv[5];
             }
             break;
         case ARGUMENT6:
-            if (_context.argc > 6) {
-                (*out) = _context.argv[6];
+            if (_context->argc > 6) {
+                (*out) = _context->argv[6];
             }
             break;
         case ARGUMENT7:
-            if (_context.argc > 7) {
-                (*out) = _context.argv[7];
+            if (_context->argc > 7) {
+                (*out) = _context->argv[7];
             }
             break;
         case ARGUMENT8:
-            if (_context.argc > 8) {
-                (*out) = _context.argv[8];
+            if (_context->argc > 8) {
+                (*out) = _context->argv[8];
             }
             break;
         case ARGUMENT9:
-            if (_context.argc > 9) {
-                (*out) = _context.argv[9];
+            if (_context->argc > 9) {
+                (*out) = _context->argv[9];
             }
             break;
         case ARGUMENT10:
-            if (_context.argc > 10) {
-                (*out) = _context.argv[10];
+            if (_context->argc > 10) {
+                (*out) = _context->argv[10];
             }
             break;
         case ARGUMENT11:
-            if (_context.argc > 11) {
-                (*out) = _context.argv[11];
+            if (_context->argc > 11) {
+                (*out) = _context->argv[11];
             }
             break;
         case ARGUMENT12:
-            if (_context.argc > 12) {
-                (*out) = _context.argv[12];
+            if (_context->argc > 12) {
+                (*out) = _context->argv[12];
             }
             break;
         case ARGUMENT13:
-            if (_context.argc > 13) {
-                (*out) = _context.argv[13];
+            if (_context->argc > 13) {
+                (*out) = _context->argv[13];
             }
             break;
         case ARGUMENT14:
-            if (_context.argc > 14) {
-                (*out) = _context.argv[14];
+            if (_context->argc > 14) {
+                (*out) = _context->argv[14];
             }
             break;
         case ARGUMENT15:
-            if (_context.argc > 15) {
-                (*out) = _context.argv[15];
+            if (_context->argc > 15) {
+                (*out) = _context->argv[15];
             }
             break;
         case CURRENT_TIME: {
@@ -355,7 +364,7 @@ bool _setGameValue(CRGameVar index, unsigned int arrayIndex, CRSetMethod method,
             lhs.state = GMLTypeState::String;
             lhs.sVal = _globalValues->room_caption;
             if (!_applySetMethod(&lhs, method, &value)) return false;
-            _globalValues->room_caption = lhs.sVal;
+            _globalValues->room_caption = lhs.sVal.str();
             break;
         case VIEW_ENABLED:
             lhs.dVal = _globalValues->view_enabled ? GMLTrue : GMLFalse;
@@ -446,7 +455,8 @@ bool _setGameValue(CRGameVar index, unsigned int arrayIndex, CRSetMethod method,
 }
 
 
-bool _setInstanceVar(Instance& instance, CRInstanceVar index, unsigned int arrayIndex, CRSetMethod method, GMLType value) {
+bool _setInstanceVar(InstanceHandle handle, CRInstanceVar index, unsigned int arrayIndex, CRSetMethod method, GMLType value) {
+    Instance& instance = InstanceList::GetInstance(handle);
     // No instance vars are strings. In GML if you set an instance var to a string, it gets set to 0.
     GMLType t;
     t.state = GMLTypeState::Double;
@@ -458,39 +468,39 @@ bool _setInstanceVar(Instance& instance, CRInstanceVar index, unsigned int array
     switch (index) {
         case IV_ALARM: {
             int alarmValue = (value.state == GMLTypeState::Double ? Runtime::_round(value.dVal) : 0);
-            instance._alarms[arrayIndex] = alarmValue;
+            AlarmManager::Set(handle, arrayIndex, alarmValue);
             break;
         }
         case IV_DIRECTION:
-            t.dVal = instance.direction;
+            t.dVal = instance.direction();
             if (!_applySetMethod(&t, method, &value)) return false;
             while (t.dVal >= 360.0) t.dVal -= 360.0;
             while (t.dVal < 0.0) t.dVal += 360.0;
-            instance.direction = (t.dVal);
-            instance.hspeed = ::cos(instance.direction * GML_PI / 180.0) * instance.speed;
-            instance.vspeed = -::sin(instance.direction * GML_PI / 180.0) * instance.speed;
+            instance.direction() = (t.dVal);
+            instance.hspeed() = ::cos(instance.direction() * GML_PI / 180.0) * instance.speed();
+            instance.vspeed() = -::sin(instance.direction() * GML_PI / 180.0) * instance.speed();
             break;
         case IV_IMAGE_SPEED:
-            t.dVal = instance.image_speed;
+            t.dVal = instance.image_speed();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.image_speed = t.dVal;
+            instance.image_speed() = t.dVal;
             break;
         case IV_FRICTION:
-            t.dVal = instance.friction;
+            t.dVal = instance.friction();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.friction = t.dVal;
+            instance.friction() = t.dVal;
             break;
         case IV_SPRITE_INDEX:
             t.dVal = instance.sprite_index;
             if (!_applySetMethod(&t, method, &value)) return false;
             instance.sprite_index = Runtime::_round(t.dVal);
-            instance.bboxIsStale = true;
+            instance.bboxIsStale() = true;
             break;
         case IV_MASK_INDEX:
             t.dVal = instance.mask_index;
             if (!_applySetMethod(&t, method, &value)) return false;
             instance.mask_index = Runtime::_round(t.dVal);
-            instance.bboxIsStale = true;
+            instance.bboxIsStale() = true;
             break;
         case IV_IMAGE_BLEND:
             t.dVal = instance.image_blend;
@@ -503,28 +513,28 @@ bool _setInstanceVar(Instance& instance, CRInstanceVar index, unsigned int array
             instance.image_alpha = t.dVal;
             break;
         case IV_IMAGE_INDEX:
-            t.dVal = instance.image_index;
+            t.dVal = instance.image_index();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.image_index = t.dVal;
-            instance.bboxIsStale = true;
+            instance.image_index() = t.dVal;
+            instance.bboxIsStale() = true;
             break;
         case IV_IMAGE_ANGLE:
             t.dVal = instance.image_angle;
             if (!_applySetMethod(&t, method, &value)) return false;
             instance.image_angle = t.dVal;
-            instance.bboxIsStale = true;
+            instance.bboxIsStale() = true;
             break;
         case IV_IMAGE_XSCALE:
             t.dVal = instance.image_xscale;
             if (!_applySetMethod(&t, method, &value)) return false;
             instance.image_xscale = t.dVal;
-            instance.bboxIsStale = true;
+            instance.bboxIsStale() = true;
             break;
         case IV_IMAGE_YSCALE:
             t.dVal = instance.image_yscale;
             if (!_applySetMethod(&t, method, &value)) return false;
             instance.image_yscale = t.dVal;
-            instance.bboxIsStale = true;
+            instance.bboxIsStale() = true;
             break;
         case IV_SOLID:
             t.dVal = (instance.solid ? GMLTrue : GMLFalse);
@@ -547,47 +557,47 @@ bool _setInstanceVar(Instance& instance, CRInstanceVar index, unsigned int array
             instance.depth = Runtime::_round(t.dVal);
             break;
         case IV_SPEED:
-            t.dVal = instance.speed;
+            t.dVal = instance.speed();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.speed = t.dVal;
-            instance.hspeed = ::cos(instance.direction * GML_PI / 180.0) * instance.speed;
-            instance.vspeed = -::sin(instance.direction * GML_PI / 180.0) * instance.speed;
+            instance.speed() = t.dVal;
+            instance.hspeed() = ::cos(instance.direction() * GML_PI / 180.0) * instance.speed();
+            instance.vspeed() = -::sin(instance.direction() * GML_PI / 180.0) * instance.speed();
             break;
         case IV_VSPEED:
-            t.dVal = instance.vspeed;
+            t.dVal = instance.vspeed();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.vspeed = t.dVal;
-            instance.direction = ::atan2(-instance.vspeed, instance.hspeed) * 180.0 / GML_PI;
-            instance.speed = ::sqrt(pow(instance.hspeed, 2) + pow(instance.vspeed, 2));
+            instance.vspeed() = t.dVal;
+            instance.direction() = ::atan2(-instance.vspeed(), instance.hspeed()) * 180.0 / GML_PI;
+            instance.speed() = ::sqrt(pow(instance.hspeed(), 2) + pow(instance.vspeed(), 2));
             break;
         case IV_HSPEED:
-            t.dVal = instance.hspeed;
+            t.dVal = instance.hspeed();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.hspeed = t.dVal;
-            instance.direction = ::atan2(-instance.vspeed, instance.hspeed) * 180.0 / GML_PI;
-            instance.speed = ::sqrt(pow(instance.hspeed, 2) + pow(instance.vspeed, 2));
+            instance.hspeed() = t.dVal;
+            instance.direction() = ::atan2(-instance.vspeed(), instance.hspeed()) * 180.0 / GML_PI;
+            instance.speed() = ::sqrt(pow(instance.hspeed(), 2) + pow(instance.vspeed(), 2));
             break;
         case IV_GRAVITY:
-            t.dVal = instance.gravity;
+            t.dVal = instance.gravity();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.gravity = t.dVal;
+            instance.gravity() = t.dVal;
             break;
         case IV_GRAVITY_DIRECTION:
-            t.dVal = instance.gravity_direction;
+            t.dVal = instance.gravity_direction();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.gravity_direction = t.dVal;
+            instance.gravity_direction() = t.dVal;
             break;
         case IV_X:
-            t.dVal = instance.x;
+            t.dVal = instance.x();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.x = t.dVal;
-            instance.bboxIsStale = true;
+            instance.x() = t.dVal;
+            instance.bboxIsStale() = true;
             break;
         case IV_Y:
-            t.dVal = instance.y;
+            t.dVal = instance.y();
             if (!_applySetMethod(&t, method, &value)) return false;
-            instance.y = t.dVal;
-            instance.bboxIsStale = true;
+            instance.y() = t.dVal;
+            instance.bboxIsStale() = true;
             break;
         case IV_PATH_INDEX:
             t.dVal = instance.path_index;
@@ -652,17 +662,12 @@ bool _setInstanceVar(Instance& instance, CRInstanceVar index, unsigned int array
     return true;
 }
 
-bool _getInstanceVar(Instance& instance, CRInstanceVar index, unsigned int arrayIndex, GMLType* out) {
+bool _getInstanceVar(InstanceHandle handle, CRInstanceVar index, unsigned int arrayIndex, GMLType* out) {
+    Instance& instance = InstanceList::GetInstance(handle);
     out->state = GMLTypeState::Double;
     switch (index) {
         case IV_ALARM:
-            // out->dVal = static_cast<double>(AlarmGet(instance.id, arrayIndex));
-            if (instance._alarms.count(arrayIndex)) {
-                out->dVal = static_cast<double>(instance._alarms[arrayIndex]);
-            }
-            else {
-                out->dVal = -1.0;
-            }
+            out->dVal = static_cast<double>(AlarmManager::Get(handle, arrayIndex));
             break;
         case IV_INSTANCE_ID:
             out->dVal = instance.id;
@@ -671,16 +676,16 @@ bool _getInstanceVar(Instance& instance, CRInstanceVar index, unsigned int array
             out->dVal = instance.object_index;
             break;
         case IV_X:
-            out->dVal = instance.x;
+            out->dVal = instance.x();
             break;
         case IV_Y:
-            out->dVal = instance.y;
+            out->dVal = instance.y();
             break;
         case IV_XPREVIOUS:
-            out->dVal = instance.xprevious;
+            out->dVal = instance.xprevious();
             break;
         case IV_YPREVIOUS:
-            out->dVal = instance.yprevious;
+            out->dVal = instance.yprevious();
             break;
         case IV_XSTART:
             out->dVal = instance.xstart;
@@ -701,31 +706,31 @@ bool _getInstanceVar(Instance& instance, CRInstanceVar index, unsigned int array
             out->dVal = (instance.persistent ? GMLTrue : GMLFalse);
             break;
         case IV_DIRECTION:
-            out->dVal = instance.direction;
+            out->dVal = instance.direction();
             break;
         case IV_SPEED:
-            out->dVal = instance.speed;
+            out->dVal = instance.speed();
             break;
         case IV_VSPEED:
-            out->dVal = instance.vspeed;
+            out->dVal = instance.vspeed();
             break;
         case IV_HSPEED:
-            out->dVal = instance.hspeed;
+            out->dVal = instance.hspeed();
             break;
         case IV_GRAVITY:
-            out->dVal = instance.gravity;
+            out->dVal = instance.gravity();
             break;
         case IV_GRAVITY_DIRECTION:
-            out->dVal = instance.gravity_direction;
+            out->dVal = instance.gravity_direction();
             break;
         case IV_FRICTION:
-            out->dVal = instance.friction;
+            out->dVal = instance.friction();
             break;
         case IV_IMAGE_INDEX:
-            out->dVal = instance.image_index;
+            out->dVal = instance.image_index();
             break;
         case IV_IMAGE_SPEED:
-            out->dVal = instance.image_speed;
+            out->dVal = instance.image_speed();
             break;
         case IV_SPRITE_INDEX:
             out->dVal = instance.sprite_index;
@@ -846,935 +851,879 @@ bool Runtime::_equal(double d1, double d2) {
 bool Runtime::_isTrue(const GMLType* value) { return (value->state == GMLTypeState::Double) && (value->dVal >= 0.5); }
 
 
-const char* Runtime::GetErrorMessage() { return _error.c_str(); }
-
-void Runtime::PushErrorMessage(const char* m) { _error += m; }
-
-bool Runtime::Execute(CRActionList& actions, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, unsigned int argc, GMLType* argv) {
-    Context c = _context;
-    _context.self = self;
-    _context.other = other;
-    _context.eventId = ev;
-    _context.eventNumber = sub;
-    _context.objId = asObjId;
-    _context.argc = argc;
-    _context.argv = argv;
-    bool result = actions.Run();
-    _context = c;
-    return result ? true : (_cause == ReturnCause::Break || _cause == ReturnCause::Continue || _cause == ReturnCause::Return || _cause == ReturnCause::ExitNormal);
-}
-
-bool Runtime::EvalExpression(CRExpression& expression, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, GMLType* out, unsigned int argc, GMLType* argv) {
-    Context c = _context;
-    _context.self = self;
-    _context.other = other;
-    _context.eventId = ev;
-    _context.eventNumber = sub;
-    _context.objId = asObjId;
-    _context.argc = argc;
-    _context.argv = argv;
-    bool result = expression.Evaluate(out);
-    _context = c;
-    return result;
-}
-
-
-bool CRActionList::Run(unsigned int start) {
-    auto i = _actions.begin() + start;
-    while (i != _actions.end()) {
-        if (!(*i)->Run()) return false;
-        i++;
+bool Runtime::FoldFunction(CRInternalFunction function, unsigned int argc, GMLType* argv, GMLType* out) {
+    if (GetPureArgCount(function) != static_cast<int>(argc)) return false;
+    for (unsigned int i = 0; i < argc; i++) {
+        if (argv[i].state != GMLTypeState::Double) return false;
     }
-    return true;
+    out->state = GMLTypeState::Double;
+    out->dVal = 0.0;
+    return (*_gmlFuncs[function])(argc, argv, out);
 }
 
-void CRActionList::Finalize() {
-    for (CRAction* action : _actions) {
-        action->Finalize();
-        delete action;
-    }
-}
 
-bool CRExpression::Evaluate(GMLType* output) {
-    if (!_values.size()) {
-        _cause = Runtime::ReturnCause::ExitError;
-        _error = "Tried to evaluate empty expression";
-        return false;
-    }
+const char* Runtime::GetErrorMessage() { return _error.c_str(); }
 
-    GMLType var;
-    if (!_values[0]->Evaluate(&var)) return false;
-    auto i = _values.begin();
-    while ((i + 1) != _values.end()) {
-        GMLType rhs;
-        if (!(*(i + 1))->Evaluate(&rhs)) return false;
+void Runtime::PushErrorMessage(const char* m) { _error += m; }
 
-        switch ((*i)->GetOperator()) {
-            case OPERATOR_ADD: {
-                if (!_applySetMethod(&var, SM_ADD, &rhs)) return false;
-                break;
-            }
-            case OPERATOR_SUBTRACT: {
-                if (!_applySetMethod(&var, SM_SUBTRACT, &rhs)) return false;
-                break;
-            }
-            case OPERATOR_MULTIPLY: {
-                if (!_applySetMethod(&var, SM_MULTIPLY, &rhs)) return false;
-                break;
-            }
-            case OPERATOR_DIVIDE: {
-                if (!_applySetMethod(&var, SM_DIVIDE, &rhs)) return false;
-                break;
-            }
-            case OPERATOR_MOD: {
-                if (var.state == GMLTypeState::String || rhs.state == GMLTypeState::String) {
-                    _cause = Runtime::ReturnCause::ExitError;
-                    _error = "Incompatible operands for operator mod: ";
-                    //_error += (var.state == GMLTypeState::Double) ? std::to_string(var.dVal) : ("\"" + var.sVal + "\"");
-                  //  _error += ", rhs: " + (rhs.state == GMLTypeState::Double) ? std::to_string(rhs.dVal) : ("\"" + rhs.sVal + "\"");
-                    return false;
-                }
-                var.dVal = std::fmod(var.dVal, rhs.dVal);
-                break;
-            }
-            case OPERATOR_DIV: {
-                if (var.state == GMLTypeState::String || rhs.state == GMLTypeState::String) {
-                    _cause = Runtime::ReturnCause::ExitError;
-                    _error = "Incompatible operands for operator div: ";
-                  //  _error += (var.state == GMLTypeState::Double) ? std::to_string(var.dVal) : ("\"" + var.sVal + "\"");
-                  //  _error += ", rhs: " + (rhs.state == GMLTypeState::Double) ? std::to_string(rhs.dVal) : ("\"" + rhs.sVal + "\"");
-                    return false;
-                }
-                var.dVal = ::floor(var.dVal / rhs.dVal);
-                break;
-            }
-            case OPERATOR_LTE: {
-                if (var.state == GMLTypeState::Double) {
-                    var.dVal = ((var.dVal < rhs.dVal || Runtime::_equal(var.dVal, rhs.dVal)) ? GMLTrue : GMLFalse);
-                }
-                else {
-                    var.dVal = (var.sVal.length() <= rhs.sVal.length() ? GMLTrue : GMLFalse);
-                }
-                var.state = GMLTypeState::Double;
-                break;
-            }
-            case OPERATOR_GTE: {
-                if (var.state == GMLTypeState::Double) {
-                    var.dVal = ((var.dVal > rhs.dVal || Runtime::_equal(var.dVal, rhs.dVal)) ? GMLTrue : GMLFalse);
-                }
-                else {
-                    var.dVal = (var.sVal.length() >= rhs.sVal.length() ? GMLTrue : GMLFalse);
-                }
-                var.state = GMLTypeState::Double;
-                break;
-            }
-            case OPERATOR_LT: {
-                if (var.state == GMLTypeState::Double) {
-                    var.dVal = (var.dVal < rhs.dVal ? GMLTrue : GMLFalse);
-                }
-                else {
-                    var.dVal = (var.sVal.length() < rhs.sVal.length() ? GMLTrue : GMLFalse);
-                }
-                var.state = GMLTypeState::Double;
-                break;
-            }
-            case OPERATOR_GT: {
-                if (var.state == GMLTypeState::Double) {
-                    var.dVal = (var.dVal > rhs.dVal ? GMLTrue : GMLFalse);
-                }
-                else {
-                    var.dVal = (var.sVal.length() > rhs.sVal.length() ? GMLTrue : GMLFalse);
-                }
-                var.state = GMLTypeState::Double;
-                break;
-            }
-            case OPERATOR_EQUALS: {
-                if (var.state == GMLTypeState::Double)
-                    var.dVal = (Runtime::_equal(var.dVal, rhs.dVal) ? GMLTrue : GMLFalse);
-                else
-                    var.dVal = (var.sVal.compare(rhs.sVal) ? GMLFalse : GMLTrue);
-                var.state = GMLTypeState::Double;
-                break;
-            }
-            case OPERATOR_NOT_EQUAL: {
-                if (var.state == GMLTypeState::Double)
-                    var.dVal = (Runtime::_equal(var.dVal, rhs.dVal) ? GMLFalse : GMLTrue);
-                else
-                    var.dVal = (var.sVal.compare(rhs.sVal) ? GMLTrue : GMLFalse);
-                var.state = GMLTypeState::Double;
-                break;
-            }
-            case OPERATOR_BOOLEAN_AND: {
-                var.dVal = (Runtime::_isTrue(&var) && Runtime::_isTrue(&rhs) ? GMLTrue : GMLFalse);
-                break;
-            }
-            case OPERATOR_BOOLEAN_OR: {
-                var.dVal = (Runtime::_isTrue(&var) || Runtime::_isTrue(&rhs) ? GMLTrue : GMLFalse);
-                break;
-            }
-            case OPERATOR_BOOLEAN_XOR: {
-                var.dVal = (Runtime::_isTrue(&var) != Runtime::_isTrue(&rhs) ? GMLTrue : GMLFalse);
-                break;
-            }
-            case OPERATOR_BITWISE_AND: {
-                if (!_applySetMethod(&var, SM_BITWISE_AND, &rhs)) return false;
-                break;
-            }
-            case OPERATOR_BITWISE_OR: {
-                if (!_applySetMethod(&var, SM_BITWISE_OR, &rhs)) return false;
-                break;
-            }
-            case OPERATOR_BITWISE_XOR: {
-                if (!_applySetMethod(&var, SM_BITWISE_XOR, &rhs)) return false;
-                break;
-            }
-            case OPERATOR_LSHIFT: {
-                if (var.state == GMLTypeState::String || rhs.state == GMLTypeState::String) {
-                    _cause = Runtime::ReturnCause::ExitError;
-                    _error = "Incompatible operands for operator <<: ";
-                   // _error += (var.state == GMLTypeState::Double) ? std::to_string(var.dVal) : ("\"" + var.sVal + "\"");
-                   // _error += ", rhs: " + (rhs.state == GMLTypeState::Double) ? std::to_string(rhs.dVal) : ("\"" + rhs.sVal + "\"");
-                    return false;
-                }
-                var.dVal = ( double )(Runtime::_round(var.dVal) << Runtime::_round(rhs.dVal));
-                break;
-            }
-            case OPERATOR_RSHIFT: {
-                if (var.state == GMLTypeState::String || rhs.state == GMLTypeState::String) {
-                    _cause = Runtime::ReturnCause::ExitError;
-                    _error = "Incompatible operands for operator >>: ";
-                 //   _error += (var.state == GMLTypeState::Double) ? std::to_string(var.dVal) : ("\"" + var.sVal + "\"");
-                 //   _error += ", rhs: " + (rhs.state == GMLTypeState::Double) ? std::to_string(rhs.dVal) : ("\"" + rhs.sVal + "\"");
-                    return false;
-                }
-                var.dVal = ( double )(Runtime::_round(var.dVal) >> Runtime::_round(rhs.dVal));
-                break;
+
+// Applies one of the less common binary operators, which don't get their own opcode
+bool _applyOperator(GMLType* var, const GMLType* rhs, CROperator op) {
+    switch (op) {
+        case OPERATOR_MOD: {
+            if (var->state == GMLTypeState::String || rhs->state == GMLTypeState::String) {
+                _cause = Runtime::ReturnCause::ExitError;
+                _error = "Incompatible operands for operator mod";
+                return false;
             }
-            default:
+            var->dVal = std::fmod(var->dVal, rhs->dVal);
+            break;
+        }
+        case OPERATOR_DIV: {
+            if (var->state == GMLTypeState::String || rhs->state == GMLTypeState::String) {
                 _cause = Runtime::ReturnCause::ExitError;
-               // _error = "Unrecognized operator: " + std::to_string((*i)->GetOperator());
-               // _error += (var.state == GMLTypeState::Double) ? std::to_string(var.dVal) : ("\"" + var.sVal + "\"");
-             //   _error += ", rhs: " + (rhs.state == GMLTypeState::Double) ? std::to_string(rhs.dVal) : ("\"" + rhs.sVal + "\"");
+                _error = "Incompatible operands for operator div";
                 return false;
+            }
+            var->dVal = ::floor(var->dVal / rhs->dVal);
+            break;
         }
-        i++;
-    }
-    (*output) = var;
-    return true;
-}
-
-void CRExpression::Finalize() {
-    for (CRExpressionValue* value : _values) {
-        value->Finalize();
-        delete value;
-    }
-}
-
-bool _evalArrayAccessor(std::vector<CRExpression>& dimensions, int* out) {
-    if (dimensions.size()) {
-        if (dimensions.size() > 2) {
-            _cause = Runtime::ReturnCause::ExitError;
-           // _error = "Tried to access " + std::to_string(dimensions.size()) + "-dimensional array; 2-dimensional is the highest supported";
-            return false;
+        case OPERATOR_BOOLEAN_XOR: {
+            var->dVal = (Runtime::_isTrue(var) != Runtime::_isTrue(rhs) ? GMLTrue : GMLFalse);
+            break;
         }
-        GMLType dim1;
-        if (!dimensions[0].Evaluate(&dim1)) return false;
-        if (dim1.state == GMLTypeState::String) {
-            _cause = Runtime::ReturnCause::ExitError;
-            _error = "Invalid array accessor: \"" + dim1.sVal + "\"";
-            return false;
+        case OPERATOR_BITWISE_AND: {
+            return _applySetMethod(var, SM_BITWISE_AND, rhs);
         }
-        (*out) = Runtime::_round(dim1.dVal);
-        if ((*out) < 0 || (*out) >= 32000) {
-            _cause = Runtime::ReturnCause::ExitError;
-            //_error = "Invalid array accessor: \"" + std::to_string(dim1.dVal) + "\"";
-            return false;
+        case OPERATOR_BITWISE_OR: {
+            return _applySetMethod(var, SM_BITWISE_OR, rhs);
         }
-
-        if (dimensions.size() == 2) {
-            GMLType dim2;
-            if (!dimensions[1].Evaluate(&dim2)) return false;
-            if (dim2.state == GMLTypeState::String) {
+        case OPERATOR_BITWISE_XOR: {
+            return _applySetMethod(var, SM_BITWISE_XOR, rhs);
+        }
+        case OPERATOR_LSHIFT: {
+            if (var->state == GMLTypeState::String || rhs->state == GMLTypeState::String) {
                 _cause = Runtime::ReturnCause::ExitError;
-                _error = "Invalid array accessor: \"" + dim1.sVal + "\"";
+                _error = "Incompatible operands for operator <<";
                 return false;
             }
-            int id2 = Runtime::_round(dim2.dVal);
-            if (id2 < 0 || id2 >= 32000) {
+            var->dVal = ( double )(Runtime::_round(var->dVal) << Runtime::_round(rhs->dVal));
+            break;
+        }
+        case OPERATOR_RSHIFT: {
+            if (var->state == GMLTypeState::String || rhs->state == GMLTypeState::String) {
                 _cause = Runtime::ReturnCause::ExitError;
-                //_error = "Invalid array accessor: \"" + std::to_string(dim1.dVal) + "\"";
+                _error = "Incompatible operands for operator >>";
                 return false;
             }
-            (*out) = ((*out) * 32000) + id2;
+            var->dVal = ( double )(Runtime::_round(var->dVal) >> Runtime::_round(rhs->dVal));
+            break;
         }
+        default:
+            _cause = Runtime::ReturnCause::ExitError;
+            _error = "Unrecognized operator";
+            return false;
     }
     return true;
 }
 
 
-bool CRActionBindVars::Run() { return true; }
+#define LOCAL_SLOT(slot) _localArena[_context->localBase + (slot)]
 
-bool CRActionAssignmentField::Run() {
-    GMLType v;
-    if (!_expression.Evaluate(&v)) return false;
-
-    if (_hasDeref) {
-        GMLType d;
-        if (!_deref.Evaluate(&d)) return false;
+// Finds a local by field number, for "local.x"
+GMLArray& _localField(unsigned int field) {
+    const std::vector<unsigned int>& fields = _context->code->localFields;
+    for (size_t i = 0; i < fields.size(); i++) {
+        if (fields[i] == field) return LOCAL_SLOT(i);
+    }
+    return _context->undeclaredLocals[field];
+}
 
-        int id = Runtime::_round(d.dVal);
-        switch (id) {
-            case SELF: {
-                if (!_applySetMethod(InstanceList::GetField(_context.self, _field), _method, &v)) return false;
-            }
-            case OTHER: {
-                if (!_applySetMethod(InstanceList::GetField(_context.other, _field), _method, &v)) return false;
-            }
-            case ALL: {
-                InstanceList::Iterator iter;
-                InstanceHandle i;
-                while ((i = iter.Next()) != InstanceList::NoInstance) {
-                    if (!_applySetMethod(InstanceList::GetField(i, _field), _method, &v)) return false;
-                }
-            }
-            case GLOBAL: {
-                if (!_applySetMethod(&_global[_field][0], _method, &v)) return false;
-                break;
+// Reads a field through a deref such as "other.x" or "global.x"
+bool _getFieldOf(int id, unsigned int field, unsigned int index, GMLType* out) {
+    switch (id) {
+        case SELF:
+            (*out) = InstanceList::ReadField(_context->self, field, index);
+            return true;
+        case OTHER:
+            (*out) = InstanceList::ReadField(_context->other, field, index);
+            return true;
+        case NOONE:
+            (*out) = GMLType();
+            return true;
+        case GLOBAL:
+            (*out) = _global[field].Read(index);
+            return true;
+        case LOCAL:
+            (*out) = _localField(field).Read(index);
+            return true;
+        default: {
+            if (id < 0 && id != ALL) {
+                _cause = Runtime::ReturnCause::ExitError;
+                _error = "Tried to dereference negative number";
+                return false;
             }
-            case LOCAL: {
-                if (!_applySetMethod(&_context.locals[_field][0], _method, &v)) return false;
-                break;
+            InstanceHandle i = (id == ALL ? InstanceList::Iterator() : InstanceList::Iterator(static_cast<unsigned int>(id))).Next();
+            if (i != InstanceList::NoInstance) {
+                (*out) = InstanceList::ReadField(i, field, index);
             }
-            default: {
-                if (id < 0) {
-                    _cause = Runtime::ReturnCause::ExitError;
-                   // _error = "Tried to dereference negative number: " + std::to_string(id);
-                    return false;
-                }
-                InstanceList::Iterator iter(static_cast<unsigned int>(id));
-                InstanceHandle i;
-                while ((i = iter.Next()) != InstanceList::NoInstance) {
-                    if (!_applySetMethod(InstanceList::GetField(i, _field), _method, &v)) return false;
-                }
+            else {
+                (*out) = GMLType();
             }
+            return true;
         }
     }
-    else {
-        if (_isLocal) {
-            // Local
-            if (!_applySetMethod(&_context.locals[_field][0], _method, &v)) return false;
-        }
-        else {
-            // Field
-            if (!_applySetMethod(InstanceList::GetField(_context.self, _field), _method, &v)) return false;
-        }
-    }
-    return true;
 }
 
-bool CRActionAssignmentArray::Run() {
-    GMLType v;
-    if (!_expression.Evaluate(&v)) return false;
-
-    int index = 0;
-    if (!_evalArrayAccessor(_dimensions, &index)) return false;
-
-    if (_hasDeref) {
-        GMLType d;
-        if (!_deref.Evaluate(&d)) return false;
-
-        int id = Runtime::_round(d.dVal);
-        switch (id) {
-            case SELF: {
-                if (!_applySetMethod(InstanceList::GetField(_context.self, _field, index), _method, &v)) return false;
-                break;
-            }
-            case OTHER: {
-                if (!_applySetMethod(InstanceList::GetField(_context.other, _field, index), _method, &v)) return false;
-                break;
-            }
-            case ALL: {
-                InstanceList::Iterator iter;
-                InstanceHandle i;
-                while ((i = iter.Next()) != InstanceList::NoInstance) {
-                    if (!_applySetMethod(InstanceList::GetField(i, _field, index), _method, &v)) return false;
-                }
-                break;
-            }
-            case GLOBAL: {
-                if (!_applySetMethod(&_global[_field][index], _method, &v)) return false;
-                break;
-            }
-            case LOCAL: {
-                if (!_applySetMethod(&_context.locals[_field][index], _method, &v)) return false;
-                break;
+// Writes a field through a deref. Writing to an object or to "all" writes to every matching instance.
+bool _setFieldOf(int id, unsigned int field, unsigned int index, CRSetMethod method, const GMLType* value) {
+    switch (id) {
+        case SELF:
+            return _applySetMethod(InstanceList::GetField(_context->self, field, index), method, value);
+        case OTHER:
+            return _applySetMethod(InstanceList::GetField(_context->other, field, index), method, value);
+        case GLOBAL:
+            return _applySetMethod(&_global[field].Write(index), method, value);
+        case LOCAL:
+            return _applySetMethod(&_localField(field).Write(index), method, value);
+        default: {
+            if (id < 0 && id != ALL) {
+                _cause = Runtime::ReturnCause::ExitError;
+                _error = "Tried to dereference negative number";
+                return false;
             }
-            default: {
-                if (id < 0) {
-                    _cause = Runtime::ReturnCause::ExitError;
-                //    _error = "Tried to dereference negative number: " + std::to_string(id);
-                    return false;
-                }
-                InstanceList::Iterator iter(static_cast<unsigned int>(id));
-                InstanceHandle i;
-                while ((i = iter.Next()) != InstanceList::NoInstance) {
-                    if (!_applySetMethod(InstanceList::GetField(i, _field, index), _method, &v)) return false;
-                }
+            InstanceList::Iterator iter = (id == ALL ? InstanceList::Iterator() : InstanceList::Iterator(static_cast<unsigned int>(id)));
+            InstanceHandle i;
+            while ((i = iter.Next()) != InstanceList::NoInstance) {
+                if (!_applySetMethod(InstanceList::GetField(i, field, index), method, value)) return false;
             }
+            return true;
         }
     }
-    else {
-        if (_isLocal) {
-            // Local
-            if (!_applySetMethod(&_context.locals[_field][index], _method, &v)) return false;
-        }
-        else {
-            // Field
-            if (!_applySetMethod(InstanceList::GetField(_context.self, _field, index), _method, &v)) return false;
-        }
-    }
-    return true;
 }
 
-bool CRActionAssignmentInstanceVar::Run() {
-    GMLType v;
-    if (!_expression.Evaluate(&v)) return false;
-
-    int index = 0;
-    if (!_evalArrayAccessor(_dimensions, &index)) return false;
-
-    if (_hasDeref) {
-        GMLType d;
-        if (!_deref.Evaluate(&d)) return false;
-
-        int id = Runtime::_round(d.dVal);
-        switch (id) {
-            case SELF: {
-                if (!_setInstanceVar(InstanceList::GetInstance(_context.self), _var, index, _method, v)) return false;
-                break;
-            }
-            case OTHER: {
-                if (!_setInstanceVar(InstanceList::GetInstance(_context.other), _var, index, _method, v)) return false;
-                break;
-            }
-            case ALL: {
-                InstanceList::Iterator iter;
-                InstanceHandle i;
-                while ((i = iter.Next()) != InstanceList::NoInstance) {
-                    if (!_setInstanceVar(InstanceList::GetInstance(i), _var, index, _method, v)) return false;
-                }
-                break;
+bool _getInstanceVarOf(int id, CRInstanceVar var, unsigned int index, GMLType* out) {
+    switch (id) {
+        case SELF:
+            return _getInstanceVar(_context->self, var, index, out);
+        case OTHER:
+            return _getInstanceVar(_context->other, var, index, out);
+        case GLOBAL:
+            (*out) = _globalInstance[var][index];
+            return true;
+        case LOCAL:
+            (*out) = _context->localInstance[var][index];
+            return true;
+        default: {
+            if (id < 0 && id != ALL) {
+                _cause = Runtime::ReturnCause::ExitError;
+                _error = "Tried to dereference negative number";
+                return false;
             }
-            case GLOBAL: {
-                if (!_applySetMethod(&_globalInstance[_var][index], _method, &v)) return false;
-                return true;
+            InstanceHandle i = (id == ALL ? InstanceList::Iterator() : InstanceList::Iterator(static_cast<unsigned int>(id))).Next();
+            if (i != InstanceList::NoInstance) {
+                return _getInstanceVar(i, var, index, out);
             }
-            case LOCAL: {
-                if (!_applySetMethod(&_context.localInstance[_var][index], _method, &v)) return false;
-                return true;
+            (*out) = GMLType();
+            return true;
+        }
+    }
+}
+
+bool _setInstanceVarOf(int id, CRInstanceVar var, unsigned int index, CRSetMethod method, const GMLType& value) {
+    switch (id) {
+        case SELF:
+            return _setInstanceVar(_context->self, var, index, method, value);
+        case OTHER:
+            return _setInstanceVar(_context->other, var, index, method, value);
+        case GLOBAL:
+            return _applySetMethod(&_globalInstance[var][index], method, &value);
+        case LOCAL:
+            return _applySetMethod(&_context->localInstance[var][index], method, &value);
+        default: {
+            if (id < 0 && id != ALL) {
+                _cause = Runtime::ReturnCause::ExitError;
+                _error = "Tried to dereference negative number";
+                return false;
             }
-            default: {
-                if (id < 0) {
-                    _cause = Runtime::ReturnCause::ExitError;
-         //           _error = "Tried to dereference negative number: " + std::to_string(id);
-                    return false;
-                }
-                InstanceList::Iterator iter(static_cast<unsigned int>(id));
-                InstanceHandle i;
-                while ((i = iter.Next()) != InstanceList::NoInstance) {
-                    if (!_setInstanceVar(InstanceList::GetInstance(i), _var, index, _method, v)) return false;
-                }
+            InstanceList::Iterator iter = (id == ALL ? InstanceList::Iterator() : InstanceList::Iterator(static_cast<unsigned int>(id)));
+            InstanceHandle i;
+            while ((i = iter.Next()) != InstanceList::NoInstance) {
+                if (!_setInstanceVar(i, var, index, method, value)) return false;
             }
+            return true;
         }
     }
-    else {
-        if (!_setInstanceVar(InstanceList::GetInstance(_context.self), _var, index, _method, v)) return false;
-    }
-    return true;
 }
 
-bool CRActionAssignmentGameVar::Run() {
-    GMLType v;
-    if (!_expression.Evaluate(&v)) return false;
 
-    int index = 0;
-    if (!_evalArrayAccessor(_dimensions, &index)) return false;
+// Registers for running code are taken from fixed-size blocks rather than one growable array, so pointers into them - such as the argv
+// given to a script - stay valid while more code runs.
+constexpr unsigned int REGISTER_BLOCK_SIZE = 1024;
+std::vector<std::vector<GMLType>> _registerBlocks;
+unsigned int _registerBlock = 0;
+unsigned int _registerTop = 0;
+
+struct RegisterMark {
+    unsigned int block;
+    unsigned int top;
+};
+
+GMLType* _pushRegisters(unsigned int count, RegisterMark* mark) {
+    mark->block = _registerBlock;
+    mark->top = _registerTop;
+    if (_registerBlocks.empty()) _registerBlocks.emplace_back(REGISTER_BLOCK_SIZE);
+    if (_registerTop + count <= _registerBlocks[_registerBlock].size()) {
+        GMLType* ret = _registerBlocks[_registerBlock].data() + _registerTop;
+        _registerTop += count;
+        return ret;
+    }
 
-    return _setGameValue(_var, index, _method, v);
+    // Doesn't fit in this block, so move up to the next one. Nothing above the current block is in use, so it's fine to replace it if it's too small.
+    _registerBlock++;
+    if (_registerBlock == _registerBlocks.size()) {
+        _registerBlocks.emplace_back(count > REGISTER_BLOCK_SIZE ? count : REGISTER_BLOCK_SIZE);
+    }
+    else if (_registerBlocks[_registerBlock].size() < count) {
+        _registerBlocks[_registerBlock] = std::vector<GMLType>(count);
+    }
+    _registerTop = count;
+    return _registerBlocks[_registerBlock].data();
 }
 
-bool CRActionBlock::Run() { return _list.Run(); }
+void _popRegisters(const RegisterMark& mark) {
+    _registerBlock = mark.block;
+    _registerTop = mark.top;
+}
 
-bool CRActionRunFunction::Run() {
-    GMLType argv[16];
-    unsigned int argc = static_cast<unsigned int>(_args.size());
-    if (argc > 16) {
+// State of each "with" statement currently running. The outer context is restored from here when the with ends.
+struct WithState {
+    InstanceHandle self;
+    InstanceHandle other;
+    unsigned int objId;
+    InstanceList::Iterator iter;
+    bool iterating;
+};
+std::vector<WithState> _withStack;
+
+
+#if defined(__GNUC__)
+#define CR_COMPUTED_GOTO
+#endif
+
+#if defined(CR_COMPUTED_GOTO)
+#define CR_LABEL(op) &&L_##op,
+#define CASE(op) L_##op:
+#define DISPATCH() goto* labels[*pc]
+#else
+#define CASE(op) case op:
+#define DISPATCH() goto dispatch
+#endif
+
+#define R(n) regs[n]
+#define INDEX(n) ((n) == CR_NO_INDEX ? 0u : static_cast<unsigned int>(regs[n].dVal))
+#define JUMP(target) pc = code + (target)
+
+// Runs bytecode in the current context. Returns true on success, including exit and return; false if there was an error or the game is ending.
+// If "out" is given, register 0 is written to it at the end, which is where expressions leave their result.
+bool _run(const CRBytecode& bytecode, GMLType* out) {
+#if defined(CR_COMPUTED_GOTO)
+    static const void* labels[] = {CR_OPCODES(CR_LABEL)};
+#endif
+    if (bytecode.code.empty()) {
+        // Code that was never compiled, because nothing asked for it. As a tree this was an empty action list or expression.
+        if (!out) return true;
         _cause = Runtime::ReturnCause::ExitError;
-       // _error = "Too many args to internal function, argc: " + std::to_string(argc) + ", function ID: " + std::to_string(_function);
+        _error = "Tried to evaluate empty expression";
         return false;
     }
-    for (unsigned int i = 0; i < argc; i++) {
-        if (!_args[i].Evaluate(argv + i)) return false;
+
+    const unsigned int* code = bytecode.code.data();
+    const unsigned int* pc = code;
+    RegisterMark mark;
+    GMLType* regs = _pushRegisters(bytecode.registerCount, &mark);
+    size_t withDepth = _withStack.size();
+
+    DISPATCH();
+#if !defined(CR_COMPUTED_GOTO)
+dispatch:
+    switch (static_cast<CROpcode>(*pc)) {
+#endif
+
+    CASE(OP_END) {
+        if (out) (*out) = R(0);
+        goto done;
+    }
+
+    CASE(OP_EXIT) {
+        _cause = Runtime::ReturnCause::ExitNormal;
+        goto done;
     }
-    bool r = (*_gmlFuncs[_function])(argc, argv, NULL);
-    return r ? true : !(_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd);
-}
 
-bool CRActionRunScript::Run() {
-    GMLType argv[16];
-    unsigned int argc = static_cast<unsigned int>(_args.size());
-    if (argc > 16) {
+    CASE(OP_RETURN) {
+        returnBuffer = R(pc[1]);
+        _cause = Runtime::ReturnCause::Return;
+        goto done;
+    }
+
+    CASE(OP_ERROR) {
         _cause = Runtime::ReturnCause::ExitError;
-      //  _error = "Too many args to internal function, argc: " + std::to_string(argc) + ", function ID: " + std::to_string(_scriptID);
-        return false;
+        _error = bytecode.constants[pc[1]].sVal.c_str();
+        goto fail;
     }
-    for (unsigned int i = 0; i < argc; i++) {
-        if (!_args[i].Evaluate(argv + i)) return false;
+
+    CASE(OP_LOAD_CONST) {
+        R(pc[1]) = bytecode.constants[pc[2]];
+        pc += 3;
+        DISPATCH();
     }
-    Script* scr = AssetManager::GetScript(_scriptID);
-    bool r = CodeManager::Run(scr->codeObj, _context.self, _context.other, _context.eventId, _context.eventNumber, _context.objId, argc, argv);
-    return r ? true : !(_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd);
-}
 
-bool CRActionIfElse::Run() {
-    GMLType v;
-    if (!_expression.Evaluate(&v)) return false;
-    if (Runtime::_isTrue(&v)) {
-        return _if->Run();
+    CASE(OP_NOT) {
+        GMLType& v = R(pc[1]);
+        if (v.state == GMLTypeState::String) goto unaryError;
+        v.dVal = (Runtime::_isTrue(&v) ? GMLFalse : GMLTrue);
+        pc += 2;
+        DISPATCH();
     }
-    else if (_else) {
-        return _else->Run();
+
+    CASE(OP_BIT_NOT) {
+        GMLType& v = R(pc[1]);
+        if (v.state == GMLTypeState::String) goto unaryError;
+        v.dVal = ~Runtime::_round(v.dVal);
+        pc += 2;
+        DISPATCH();
     }
-    return true;
-}
 
-bool CRActionWith::Run() {
-    GMLType v;
-    if (!_expression.Evaluate(&v)) return false;
-    if (v.state != GMLTypeState::Double) {
-        _cause = Runtime::ReturnCause::ExitError;
-        _error = "Invalid 'with' parameter: \"" + v.sVal + "\"";
-        return false;
+    CASE(OP_NEGATE) {
+        GMLType& v = R(pc[1]);
+        if (v.state == GMLTypeState::String) goto unaryError;
+        v.dVal = -v.dVal;
+        pc += 2;
+        DISPATCH();
     }
-    int objID = Runtime::_round(v.dVal);
 
-    switch (objID) {
-        case SELF:
-            return _code->Run();
-        case OTHER: {
-            Runtime::Context c = _context;
-            _context.self = c.other;
-            _context.other = c.self;
-            _context.objId = InstanceList::GetInstance(c.other).object_index;
-            bool r = _code->Run();
-            c.locals = _context.locals;
-            c.localInstance = _context.localInstance;
-            _context = c;
-            return r ? true : (_cause == Runtime::ReturnCause::Break || _cause == Runtime::ReturnCause::Continue);
+    CASE(OP_CHECK_REAL) {
+        if (R(pc[1]).state == GMLTypeState::String) goto unaryError;
+        pc += 2;
+        DISPATCH();
+    }
+
+    CASE(OP_ADD) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double && rhs.state == GMLTypeState::Double) {
+            lhs.dVal += rhs.dVal;
         }
-        case ALL: {
-            Runtime::Context c = _context;
-            _context.other = c.self;
-            InstanceList::Iterator iter;
-            InstanceHandle i;
-            while ((i = iter.Next()) != InstanceList::NoInstance) {
-                _context.self = i;
-                _context.objId = InstanceList::GetInstance(i).object_index;
-                if (!_code->Run()) {
-                    if (_cause == Runtime::ReturnCause::Continue)
-                        continue;
-                    else {
-                        c.locals = _context.locals;
-                        c.localInstance = _context.localInstance;
-                        _context = c;
-                        return (_cause == Runtime::ReturnCause::Break);
-                    }
-                }
-            }
-            c.locals = _context.locals;
-            c.localInstance = _context.localInstance;
-            _context = c;
-            return true;
+        else if (!_applySetMethod(&lhs, SM_ADD, &rhs)) {
+            goto fail;
         }
-        case NOONE: {
-            return true;
+        pc += 3;
+        DISPATCH();
+    }
+
+    CASE(OP_SUBTRACT) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double && rhs.state == GMLTypeState::Double) {
+            lhs.dVal -= rhs.dVal;
         }
-        default: {
-            if (objID < 0) {
-                _cause = Runtime::ReturnCause::ExitError;
-            //    _error = "Tried to pass negative number to 'with': " + std::to_string(objID);
-                return false;
-            }
-            Runtime::Context c = _context;
-            _context.other = c.self;
-            InstanceList::Iterator iter(objID);
-            InstanceHandle i;
-            while ((i = iter.Next()) != InstanceList::NoInstance) {
-                _context.self = i;
-                _context.objId = InstanceList::GetInstance(i).object_index;
-                if (!_code->Run()) {
-                    if (_cause == Runtime::ReturnCause::Continue)
-                        continue;
-                    else {
-                        c.locals = _context.locals;
-                        c.localInstance = _context.localInstance;
-                        _context = c;
-                        return (_cause == Runtime::ReturnCause::Break);
-                    }
-                }
-            }
-            c.locals = _context.locals;
-            c.localInstance = _context.localInstance;
-            _context = c;
-            return true;
+        else if (!_applySetMethod(&lhs, SM_SUBTRACT, &rhs)) {
+            goto fail;
         }
+        pc += 3;
+        DISPATCH();
     }
-}
 
-bool CRActionRepeat::Run() {
-    GMLType v;
-    if (!_expression.Evaluate(&v)) return false;
-    if (v.state != GMLTypeState::Double) {
-        _cause = Runtime::ReturnCause::ExitError;
-        _error = "Invalid repeat count: \"" + v.sVal + "\"";
-        return false;
+    CASE(OP_MULTIPLY) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double && rhs.state == GMLTypeState::Double) {
+            lhs.dVal *= rhs.dVal;
+        }
+        else if (!_applySetMethod(&lhs, SM_MULTIPLY, &rhs)) {
+            goto fail;
+        }
+        pc += 3;
+        DISPATCH();
     }
-    int count = Runtime::_round(v.dVal);
-    for (int i = 0; i < count; i++) {
-        if (!_code->Run()) {
-            if (_cause == Runtime::ReturnCause::Continue)
-                continue;
-            else
-                return (_cause == Runtime::ReturnCause::Break);
+
+    CASE(OP_DIVIDE) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double && rhs.state == GMLTypeState::Double) {
+            lhs.dVal /= rhs.dVal;
+        }
+        else if (!_applySetMethod(&lhs, SM_DIVIDE, &rhs)) {
+            goto fail;
         }
+        pc += 3;
+        DISPATCH();
     }
-    return true;
-}
 
-bool CRActionWhile::Run() {
-    while (true) {
-        GMLType out;
-        if (!_expression.Evaluate(&out)) return false;
-        if (Runtime::_isTrue(&out)) {
-            if (!_code->Run()) {
-                if (_cause == Runtime::ReturnCause::Continue)
-                    continue;
-                else
-                    return (_cause == Runtime::ReturnCause::Break);
-            }
+    CASE(OP_EQUALS) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double) {
+            lhs.dVal = (Runtime::_equal(lhs.dVal, rhs.dVal) ? GMLTrue : GMLFalse);
         }
         else {
-            return true;
+            lhs.dVal = (lhs.sVal.compare(rhs.sVal) ? GMLFalse : GMLTrue);
+            lhs.state = GMLTypeState::Double;
         }
+        pc += 3;
+        DISPATCH();
     }
-}
 
-bool CRActionDoUntil::Run() {
-    while (true) {
-        if (!_code->Run()) {
-            if (_cause == Runtime::ReturnCause::Continue)
-                continue;
-            else
-                return (_cause == Runtime::ReturnCause::Break);
+    CASE(OP_NOT_EQUAL) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double) {
+            lhs.dVal = (Runtime::_equal(lhs.dVal, rhs.dVal) ? GMLFalse : GMLTrue);
         }
-        GMLType out;
-        if (!_expression.Evaluate(&out)) return false;
-        if (Runtime::_isTrue(&out)) {
-            return true;
+        else {
+            lhs.dVal = (lhs.sVal.compare(rhs.sVal) ? GMLTrue : GMLFalse);
+            lhs.state = GMLTypeState::Double;
         }
+        pc += 3;
+        DISPATCH();
     }
-}
 
-bool CRActionFor::Run() {
-    if (!_initializer->Run()) return false;
-    while (true) {
-        GMLType out;
-        if (!_check.Evaluate(&out)) return false;
-        if (Runtime::_isTrue(&out)) {
-            if (!_code->Run()) {
-                if (_cause == Runtime::ReturnCause::Continue)
-                    continue;
-                else
-                    return (_cause == Runtime::ReturnCause::Break);
-            }
-            if (!_finalizer->Run()) return false;
+    // Strings are compared by length
+    CASE(OP_LT) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double) {
+            lhs.dVal = (lhs.dVal < rhs.dVal ? GMLTrue : GMLFalse);
         }
         else {
-            return true;
+            lhs.dVal = (lhs.sVal.length() < rhs.sVal.length() ? GMLTrue : GMLFalse);
+            lhs.state = GMLTypeState::Double;
         }
+        pc += 3;
+        DISPATCH();
     }
-}
 
-bool CRActionSwitch::Run() {
-    GMLType exp;
-    if (!_expression.Evaluate(&exp)) return false;
-    unsigned int offset = _defaultOffset;
-    for (SwitchCase& c : _cases) {
-        GMLType caseExp;
-        if (!c.expression.Evaluate(&caseExp)) return false;
-        if (caseExp.state == exp.state) {
-            if (exp.state == GMLTypeState::Double) {
-                if (Runtime::_equal(exp.dVal, caseExp.dVal)) {
-                    offset = c.offset;
-                    break;
-                }
-            }
-            else {
-                if (exp.sVal == caseExp.sVal) {
-                    offset = c.offset;
-                    break;
-                }
-            }
+    CASE(OP_LTE) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double) {
+            lhs.dVal = ((lhs.dVal < rhs.dVal || Runtime::_equal(lhs.dVal, rhs.dVal)) ? GMLTrue : GMLFalse);
+        }
+        else {
+            lhs.dVal = (lhs.sVal.length() <= rhs.sVal.length() ? GMLTrue : GMLFalse);
+            lhs.state = GMLTypeState::Double;
         }
+        pc += 3;
+        DISPATCH();
     }
-    bool r = _actions.Run(offset);
-    return r ? true : (_cause == Runtime::ReturnCause::Break);
-}
 
-bool CRActionBreak::Run() {
-    _cause = Runtime::ReturnCause::Break;
-    return false;
-}
+    CASE(OP_GT) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double) {
+            lhs.dVal = (lhs.dVal > rhs.dVal ? GMLTrue : GMLFalse);
+        }
+        else {
+            lhs.dVal = (lhs.sVal.length() > rhs.sVal.length() ? GMLTrue : GMLFalse);
+            lhs.state = GMLTypeState::Double;
+        }
+        pc += 3;
+        DISPATCH();
+    }
 
-bool CRActionContinue::Run() {
-    _cause = Runtime::ReturnCause::Continue;
-    return false;
-}
+    CASE(OP_GTE) {
+        GMLType& lhs = R(pc[1]);
+        const GMLType& rhs = R(pc[2]);
+        if (lhs.state == GMLTypeState::Double) {
+            lhs.dVal = ((lhs.dVal > rhs.dVal || Runtime::_equal(lhs.dVal, rhs.dVal)) ? GMLTrue : GMLFalse);
+        }
+        else {
+            lhs.dVal = (lhs.sVal.length() >= rhs.sVal.length() ? GMLTrue : GMLFalse);
+            lhs.state = GMLTypeState::Double;
+        }
+        pc += 3;
+        DISPATCH();
+    }
 
-bool CRActionExit::Run() {
-    _cause = Runtime::ReturnCause::ExitNormal;
-    return false;
-}
+    CASE(OP_BOOLEAN_AND) {
+        R(pc[1]).dVal = (Runtime::_isTrue(&R(pc[1])) && Runtime::_isTrue(&R(pc[2])) ? GMLTrue : GMLFalse);
+        pc += 3;
+        DISPATCH();
+    }
 
-bool CRActionReturn::Run() {
-    if (!_expression.Evaluate(&returnBuffer)) return false;
-    _cause = Runtime::ReturnCause::Return;
-    return false;
-}
+    CASE(OP_BOOLEAN_OR) {
+        R(pc[1]).dVal = (Runtime::_isTrue(&R(pc[1])) || Runtime::_isTrue(&R(pc[2])) ? GMLTrue : GMLFalse);
+        pc += 3;
+        DISPATCH();
+    }
 
-bool CRExpLiteral::_evaluate(GMLType* output) {
-    (*output) = _value;
-    return true;
-}
+    CASE(OP_OPERATOR) {
+        if (!_applyOperator(&R(pc[1]), &R(pc[2]), static_cast<CROperator>(pc[3]))) goto fail;
+        pc += 4;
+        DISPATCH();
+    }
 
-bool CRExpFunction::_evaluate(GMLType* output) {
-    GMLType argv[16];
-    unsigned int argc = static_cast<unsigned int>(_args.size());
-    for (unsigned int i = 0; i < argc; i++) {
-        if (!_args[i].Evaluate(argv + i)) return false;
+    CASE(OP_ARRAY_INDEX) {
+        GMLType& v = R(pc[1]);
+        if (v.state == GMLTypeState::String) {
+            _cause = Runtime::ReturnCause::ExitError;
+            _error = "Invalid array accessor: \"" + v.sVal.str() + "\"";
+            goto fail;
+        }
+        int index = Runtime::_round(v.dVal);
+        if (index < 0 || index >= static_cast<int>(GML_ARRAY_SIZE)) {
+            _cause = Runtime::ReturnCause::ExitError;
+            _error = "Invalid array accessor";
+            goto fail;
+        }
+        v.dVal = static_cast<double>(index);
+        pc += 2;
+        DISPATCH();
     }
-    bool r = (*_gmlFuncs[_function])(argc, argv, output);
-    return r ? true : !(_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd);
-}
 
-bool CRExpScript::_evaluate(GMLType* output) {
-    GMLType argv[16];
-    unsigned int argc = static_cast<unsigned int>(_args.size());
-    for (unsigned int i = 0; i < argc; i++) {
-        if (!_args[i].Evaluate(argv + i)) return false;
+    CASE(OP_ARRAY_INDEX_2D) {
+        R(pc[1]).dVal = (R(pc[1]).dVal * GML_ARRAY_SIZE) + R(pc[2]).dVal;
+        pc += 3;
+        DISPATCH();
     }
-    Script* scr = AssetManager::GetScript(_script);
-    bool r = CodeManager::Run(scr->codeObj, _context.self, _context.other, _context.eventId, _context.eventNumber, _context.objId, argc, argv);
-    return r ? true : !(_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd);
-}
 
-bool CRExpNestedExpression::_evaluate(GMLType* output) { return _expression.Evaluate(output); }
+    CASE(OP_GET_FIELD) {
+        R(pc[1]) = InstanceList::ReadField(_context->self, pc[2]);
+        pc += 3;
+        DISPATCH();
+    }
 
-bool CRExpField::_evaluate(GMLType* output) {
-    if (_hasDeref) {
-        GMLType d;
-        if (!_deref.Evaluate(&d)) return false;
+    CASE(OP_GET_FIELD_ARRAY) {
+        R(pc[1]) = InstanceList::ReadField(_context->self, pc[2], INDEX(pc[3]));
+        pc += 4;
+        DISPATCH();
+    }
 
-        int id = Runtime::_round(d.dVal);
-        switch (id) {
-            case SELF: {
-                (*output) = *InstanceList::GetField(_context.self, _fieldNumber);
-                return true;
-            }
-            case OTHER: {
-                (*output) = *InstanceList::GetField(_context.other, _fieldNumber);
-                return true;
-            }
-            case ALL: {
-                InstanceHandle i = InstanceList::Iterator().Next();
-                (*output) = *InstanceList::GetField(i, _fieldNumber);
-                return true;
-            }
-            case NOONE: {
-                (*output) = GMLType();
-                return true;
-            }
-            case GLOBAL: {
-                (*output) = _global[_fieldNumber][0];
-                return true;
-            }
-            case LOCAL: {
-                (*output) = _context.locals[_fieldNumber][0];
-                return true;
-            }
-            default: {
-                if (id < 0) {
-                    _cause = Runtime::ReturnCause::ExitError;
-                 //   _error = "Tried to dereference negative number: " + std::to_string(id);
-                    return false;
-                }
-                InstanceHandle i = InstanceList::Iterator(static_cast<unsigned int>(id)).Next();
-                if (i != InstanceList::NoInstance) {
-                    (*output) = *InstanceList::GetField(i, _fieldNumber);
-                }
-                else {
-                    (*output) = GMLType();
-                }
-                return true;
-            }
+    CASE(OP_GET_LOCAL) {
+        R(pc[1]) = LOCAL_SLOT(pc[2]).Read(0);
+        pc += 3;
+        DISPATCH();
+    }
+
+    CASE(OP_GET_LOCAL_ARRAY) {
+        R(pc[1]) = LOCAL_SLOT(pc[2]).Read(INDEX(pc[3]));
+        pc += 4;
+        DISPATCH();
+    }
+
+    CASE(OP_GET_FIELD_OF) {
+        if (!_getFieldOf(Runtime::_round(R(pc[3]).dVal), pc[2], INDEX(pc[4]), &R(pc[1]))) goto fail;
+        pc += 5;
+        DISPATCH();
+    }
+
+    CASE(OP_GET_INSTANCE_VAR) {
+        if (!_getInstanceVar(_context->self, static_cast<CRInstanceVar>(pc[2]), INDEX(pc[3]), &R(pc[1]))) goto fail;
+        pc += 4;
+        DISPATCH();
+    }
+
+    CASE(OP_GET_INSTANCE_VAR_OF) {
+        if (!_getInstanceVarOf(Runtime::_round(R(pc[3]).dVal), static_cast<CRInstanceVar>(pc[2]), INDEX(pc[4]), &R(pc[1]))) goto fail;
+        pc += 5;
+        DISPATCH();
+    }
+
+    CASE(OP_GET_GAME_VAR) {
+        if (!_getGameValue(static_cast<CRGameVar>(pc[2]), INDEX(pc[3]), &R(pc[1]))) goto fail;
+        pc += 4;
+        DISPATCH();
+    }
+
+    CASE(OP_SET_FIELD) {
+        if (!_applySetMethod(InstanceList::GetField(_context->self, pc[1]), static_cast<CRSetMethod>(pc[2]), &R(pc[3]))) goto fail;
+        pc += 4;
+        DISPATCH();
+    }
+
+    CASE(OP_SET_FIELD_ARRAY) {
+        if (!_applySetMethod(InstanceList::GetField(_context->self, pc[1], INDEX(pc[4])), static_cast<CRSetMethod>(pc[2]), &R(pc[3]))) goto fail;
+        pc += 5;
+        DISPATCH();
+    }
+
+    CASE(OP_SET_LOCAL) {
+        if (!_applySetMethod(&LOCAL_SLOT(pc[1]).Write(0), static_cast<CRSetMethod>(pc[2]), &R(pc[3]))) goto fail;
+        pc += 4;
+        DISPATCH();
+    }
+
+    CASE(OP_SET_LOCAL_ARRAY) {
+        if (!_applySetMethod(&LOCAL_SLOT(pc[1]).Write(INDEX(pc[4])), static_cast<CRSetMethod>(pc[2]), &R(pc[3]))) goto fail;
+        pc += 5;
+        DISPATCH();
+    }
+
+    CASE(OP_SET_FIELD_OF) {
+        if (!_setFieldOf(Runtime::_round(R(pc[4]).dVal), pc[1], INDEX(pc[5]), static_cast<CRSetMethod>(pc[2]), &R(pc[3]))) goto fail;
+        pc += 6;
+        DISPATCH();
+    }
+
+    CASE(OP_SET_INSTANCE_VAR) {
+        if (!_setInstanceVar(_context->self, static_cast<CRInstanceVar>(pc[1]), INDEX(pc[4]), static_cast<CRSetMethod>(pc[2]), R(pc[3]))) goto fail;
+        pc += 5;
+        DISPATCH();
+    }
+
+    CASE(OP_SET_INSTANCE_VAR_OF) {
+        if (!_setInstanceVarOf(Runtime::_round(R(pc[4]).dVal), static_cast<CRInstanceVar>(pc[1]), INDEX(pc[5]), static_cast<CRSetMethod>(pc[2]), R(pc[3]))) goto fail;
+        pc += 6;
+        DISPATCH();
+    }
+
+    CASE(OP_SET_GAME_VAR) {
+        if (!_setGameValue(static_cast<CRGameVar>(pc[1]), INDEX(pc[4]), static_cast<CRSetMethod>(pc[2]), R(pc[3]))) goto fail;
+        pc += 5;
+        DISPATCH();
+    }
+
+    // A function or script returning false only stops the code if it's an error or the game is ending
+    CASE(OP_CALL) {
+        GMLType& v = R(pc[1]);
+        v.state = GMLTypeState::Double;
+        v.dVal = 0.0;
+        v.sVal.clear();
+        if (!(*_gmlFuncs[pc[2]])(pc[4], &R(pc[3]), &v)) {
+            if (_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd) goto fail;
         }
+        pc += 5;
+        DISPATCH();
     }
-    else {
-        if (_isLocal) {
-            // Local
-            (*output) = _context.locals[_fieldNumber][0];
-            return true;
+
+    CASE(OP_CALL_VOID) {
+        if (!(*_gmlFuncs[pc[1]])(pc[3], &R(pc[2]), NULL)) {
+            if (_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd) goto fail;
+        }
+        pc += 4;
+        DISPATCH();
+    }
+
+    CASE(OP_CALL_REAL) {
+        GMLType& v = R(pc[1]);
+        GMLType& arg = R(pc[3]);
+        if (arg.state == GMLTypeState::Double) {
+            v.dVal = (*_realFuncs[pc[2]])(arg.dVal);
+            v.state = GMLTypeState::Double;
+            v.sVal.clear();
         }
         else {
-            // Field
-            (*output) = *InstanceList::GetField(_context.self, _fieldNumber);
-            return true;
+            v.state = GMLTypeState::Double;
+            v.dVal = 0.0;
+            v.sVal.clear();
+            if (!(*_gmlFuncs[pc[2]])(1, &arg, &v)) {
+                if (_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd) goto fail;
+            }
         }
+        pc += 4;
+        DISPATCH();
     }
-    return true;
-}
 
-bool CRExpArray::_evaluate(GMLType* output) {
-    int index = 0;
-    if (!_evalArrayAccessor(_dimensions, &index)) return false;
+    CASE(OP_SCRIPT) {
+        Script* scr = AssetManager::GetScript(pc[2]);
+        if (!CodeManager::Run(scr->codeObj, _context->self, _context->other, _context->eventId, _context->eventNumber, _context->objId, pc[4], &R(pc[3]))) {
+            if (_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd) goto fail;
+        }
+        GMLType& v = R(pc[1]);
+        v.state = GMLTypeState::Double;
+        v.dVal = 0.0;
+        v.sVal.clear();
+        pc += 5;
+        DISPATCH();
+    }
 
-    if (_hasDeref) {
-        GMLType d;
-        if (!_deref.Evaluate(&d)) return false;
+    CASE(OP_SCRIPT_VOID) {
+        Script* scr = AssetManager::GetScript(pc[1]);
+        if (!CodeManager::Run(scr->codeObj, _context->self, _context->other, _context->eventId, _context->eventNumber, _context->objId, pc[3], &R(pc[2]))) {
+            if (_cause == Runtime::ReturnCause::ExitError || _cause == Runtime::ReturnCause::ExitGameEnd) goto fail;
+        }
+        pc += 4;
+        DISPATCH();
+    }
 
-        int id = Runtime::_round(d.dVal);
-        switch (id) {
-            case SELF: {
-                (*output) = *InstanceList::GetField(_context.self, _fieldNumber, index);
-                return true;
-            }
-            case OTHER: {
-                (*output) = *InstanceList::GetField(_context.other, _fieldNumber, index);
-                return true;
-            }
-            case ALL: {
-                InstanceHandle i = InstanceList::Iterator().Next();
-                if (i) {
-                    (*output) = *InstanceList::GetField(i, _fieldNumber, index);
-                }
-                else {
-                    (*output) = GMLType();
-                }
-                return true;
-            }
-            case NOONE: {
-                (*output) = GMLType();
-                return true;
-            }
-            case GLOBAL: {
-                (*output) = _global[_fieldNumber][index];
-                return true;
-            }
-            case LOCAL: {
-                (*output) = _context.locals[_fieldNumber][index];
-                return true;
-            }
-            default: {
-                if (id < 0) {
-                    _cause = Runtime::ReturnCause::ExitError;
-                 //   _error = "Tried to dereference negative number: " + std::to_string(id);
-                    return false;
-                }
-                InstanceHandle i = InstanceList::Iterator(static_cast<unsigned int>(id)).Next();
-                if (i != InstanceList::NoInstance) {
-                    (*output) = *InstanceList::GetField(i, _fieldNumber, index);
-                }
-                else {
-                    (*output) = GMLType();
-                }
-                return true;
-            }
+    CASE(OP_JUMP) {
+        JUMP(pc[1]);
+        DISPATCH();
+    }
+
+    CASE(OP_JUMP_IF_FALSE) {
+        if (Runtime::_isTrue(&R(pc[1]))) {
+            pc += 3;
         }
+        else {
+            JUMP(pc[2]);
+        }
+        DISPATCH();
     }
-    else {
-        if (_isLocal) {
-            // Local
-            (*output) = _context.locals[_fieldNumber][index];
-            return true;
+
+    CASE(OP_JUMP_IF_TRUE) {
+        if (Runtime::_isTrue(&R(pc[1]))) {
+            JUMP(pc[2]);
         }
         else {
-            // Field
-            (*output) = *InstanceList::GetField(_context.self, _fieldNumber, index);
-            return true;
+            pc += 3;
         }
+        DISPATCH();
+    }
+
+    CASE(OP_JUMP_IF_CASE) {
+        const GMLType& value = R(pc[1]);
+        const GMLType& c = R(pc[2]);
+        bool match = false;
+        if (value.state == c.state) {
+            match = (value.state == GMLTypeState::Double ? Runtime::_equal(value.dVal, c.dVal) : (value.sVal == c.sVal));
+        }
+        if (match) {
+            JUMP(pc[3]);
+        }
+        else {
+            pc += 4;
+        }
+        DISPATCH();
+    }
+
+    CASE(OP_REPEAT_BEGIN) {
+        GMLType& v = R(pc[1]);
+        if (v.state != GMLTypeState::Double) {
+            _cause = Runtime::ReturnCause::ExitError;
+            _error = "Invalid repeat count: \"" + v.sVal.str() + "\"";
+            goto fail;
+        }
+        v.dVal = static_cast<double>(Runtime::_round(v.dVal));
+        pc += 2;
+        DISPATCH();
     }
-    return true;
-}
 
-bool CRExpInstanceVar::_evaluate(GMLType* output) {
-    int index = 0;
-    if (!_evalArrayAccessor(_dimensions, &index)) return false;
+    CASE(OP_REPEAT_STEP) {
+        GMLType& v = R(pc[1]);
+        if (v.dVal > 0.0) {
+            v.dVal -= 1.0;
+            JUMP(pc[2]);
+        }
+        else {
+            pc += 3;
+        }
+        DISPATCH();
+    }
 
-    if (_hasDeref) {
-        GMLType d;
-        if (!_deref.Evaluate(&d)) return false;
+    CASE(OP_WITH_BEGIN) {
+        const GMLType& v = R(pc[1]);
+        if (v.state != GMLTypeState::Double) {
+            _cause = Runtime::ReturnCause::ExitError;
+            _error = "Invalid 'with' parameter: \"" + v.sVal.str() + "\"";
+            goto fail;
+        }
+        int id = Runtime::_round(v.dVal);
 
-        int id = Runtime::_round(d.dVal);
+        WithState w;
+        w.self = _context->self;
+        w.other = _context->other;
+        w.objId = _context->objId;
+        w.iterating = false;
         switch (id) {
-            case SELF: {
-                return _getInstanceVar(InstanceList::GetInstance(_context.self), _var, index, output);
-            }
-            case OTHER: {
-                return _getInstanceVar(InstanceList::GetInstance(_context.other), _var, index, output);
-            }
-            case ALL: {
-                InstanceHandle i = InstanceList::Iterator().Next();
-                if (i) {
-                    return _getInstanceVar(InstanceList::GetInstance(i), _var, index, output);
-                }
-                else {
-                    (*output) = GMLType();
-                    return true;
-                }
-            }
-            case GLOBAL: {
-                (*output) = _globalInstance[_var][index];
-                return true;
-            }
-            case LOCAL: {
-                (*output) = _context.localInstance[_var][index];
-                return true;
-            }
+            case SELF:
+                _withStack.push_back(w);
+                break;
+            case OTHER:
+                _withStack.push_back(w);
+                _context->self = w.other;
+                _context->other = w.self;
+                _context->objId = InstanceList::GetInstance(w.other).object_index;
+                break;
+            case NOONE:
+                JUMP(pc[2]);
+                DISPATCH();
             default: {
-                if (id < 0) {
+                if (id < 0 && id != ALL) {
                     _cause = Runtime::ReturnCause::ExitError;
-             //       _error = "Tried to dereference negative number: " + std::to_string(id);
-                    return false;
+                    _error = "Tried to pass negative number to 'with'";
+                    goto fail;
                 }
-                InstanceHandle i = InstanceList::Iterator(static_cast<unsigned int>(id)).Next();
-                if (i != InstanceList::NoInstance) {
-                    return _getInstanceVar(InstanceList::GetInstance(i), _var, index, output);
-                }
-                else {
-                    (*output) = GMLType();
-                    return true;
+                w.iter = (id == ALL ? InstanceList::Iterator() : InstanceList::Iterator(static_cast<unsigned int>(id)));
+                w.iterating = true;
+                InstanceHandle i = w.iter.Next();
+                if (i == InstanceList::NoInstance) {
+                    JUMP(pc[2]);
+                    DISPATCH();
                 }
+                _withStack.push_back(w);
+                _context->self = i;
+                _context->other = w.self;
+                _context->objId = InstanceList::GetInstance(i).object_index;
+                break;
             }
         }
+        pc += 3;
+        DISPATCH();
     }
-    else {
-        return _getInstanceVar(InstanceList::GetInstance(_context.self), _var, index, output);
+
+    CASE(OP_WITH_NEXT) {
+        WithState& w = _withStack.back();
+        if (w.iterating) {
+            InstanceHandle i = w.iter.Next();
+            if (i != InstanceList::NoInstance) {
+                _context->self = i;
+                _context->objId = InstanceList::GetInstance(i).object_index;
+                JUMP(pc[1]);
+                DISPATCH();
+            }
+        }
+        pc += 2;
+        DISPATCH();
+    }
+
+    CASE(OP_WITH_END) {
+        const WithState& w = _withStack.back();
+        _context->self = w.self;
+        _context->other = w.other;
+        _context->objId = w.objId;
+        _withStack.pop_back();
+        pc += 1;
+        DISPATCH();
     }
+
+#if !defined(CR_COMPUTED_GOTO)
+    }
+#endif
+
+unaryError:
+    _cause = Runtime::ReturnCause::ExitError;
+    _error = "Tried to apply unary operator to string";
+fail:
+    _popRegisters(mark);
+    _withStack.resize(withDepth);
+    return false;
+
+done:
+    _popRegisters(mark);
+    _withStack.resize(withDepth);
     return true;
 }
 
-bool CRExpGameVar::_evaluate(GMLType* output) {
-    int index = 0;
-    if (!_evalArrayAccessor(_dimensions, &index)) return false;
-    return _getGameValue(_var, index, output);
+#undef CR_LABEL
+#undef CASE
+#undef DISPATCH
+#undef R
+#undef INDEX
+#undef JUMP
+#undef LOCAL_SLOT
+
+
+bool Runtime::Execute(const CRBytecode& code, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, unsigned int argc, GMLType* argv) {
+    _pushFrame(code, self, other, ev, sub, asObjId, argc, argv);
+    bool result = _run(code, nullptr);
+    _popFrame();
+    return result;
+}
+
+bool Runtime::EvalExpression(const CRBytecode& code, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, GMLType* out, unsigned int argc, GMLType* argv) {
+    _pushFrame(code, self, other, ev, sub, asObjId, argc, argv);
+    bool result = _run(code, out);
+    _popFrame();
+    return result;
 }
@@ -4,10 +4,10 @@
 #include <map>
 
 struct GMLType;
+class GMLArray;
 struct GlobalValues;
 typedef unsigned int InstanceHandle;
-class CRActionList;
-class CRExpression;
+struct CRBytecode;
 
 constexpr int SELF = -1;
 constexpr int OTHER = -2;
@@ -35,7 +35,7 @@ namespace Runtime {
     const char* GetErrorMessage();
     void PushErrorMessage(const char*);
 
-    // Runtime context
+    // Runtime context - the frame of the innermost code that's running. Each Execute() or EvalExpression() gets a fresh one, with no locals.
     struct Context {
         InstanceHandle self;
         InstanceHandle other;
@@ -44,16 +44,30 @@ namespace Runtime {
         unsigned int objId;
         unsigned int argc;
         const GMLType* argv;
-        std::map<unsigned int, std::map<unsigned int, GMLType>> locals;
+        const CRBytecode* code;
+        unsigned int localBase;                            // Where this frame's var locals start in the locals arena, one per slot
+        std::map<unsigned int, GMLArray> undeclaredLocals;  // Anything set through "local." which wasn't declared with var
         std::map<CRInstanceVar, std::map<unsigned int, GMLType>> localInstance;
     };
     Context& GetContext();
 
-    bool Execute(CRActionList&, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, unsigned int argc = 0, GMLType* argv = nullptr);
-    bool EvalExpression(CRExpression&, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, GMLType* out, unsigned int argc = 0, GMLType* argv = nullptr);
+    // Run compiled code as the given instance. These return false if there was an error or the game is ending.
+    bool Execute(const CRBytecode&, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, unsigned int argc = 0, GMLType* argv = nullptr);
+    bool EvalExpression(const CRBytecode&, InstanceHandle self, InstanceHandle other, int ev, int sub, unsigned int asObjId, GMLType* out, unsigned int argc = 0, GMLType* argv = nullptr);
 
     bool _assertArgs(unsigned int& argc, GMLType* argv, unsigned int arge, bool lenient, ...);
 
+    // Fast path for an internal function that takes one real and gives back a real, or nullptr if it hasn't got one.
+    // It's only used when the argument really is a real, so it does the same thing as the full function without any checks.
+    typedef double (*RealFunction)(double);
+    RealFunction GetRealFunction(CRInternalFunction function);
+
+    // How many reals a pure internal function takes, or -1 if it isn't pure. A pure function always gives a real, which only depends on its arguments,
+    // and does nothing else.
+    int GetPureArgCount(CRInternalFunction function);
+    // Calls a pure function at compile time. This returns false, without touching anything else, unless the arguments are the right number of reals and the call succeeds.
+    bool FoldFunction(CRInternalFunction function, unsigned int argc, GMLType* argv, GMLType* out);
+
     // GML internal functions
     bool abs(unsigned int argc, GMLType* argv, GMLType* out);
     bool arcsin(unsigned int argc, GMLType* argv, GMLType* out);
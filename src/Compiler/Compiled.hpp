@@ -3,10 +3,17 @@
 #include "CREnums.hpp"
 #include "CRGMLType.hpp"
 
+// The parse tree built by the Interpreter. Nothing runs it directly: straight after parsing, it's lowered to bytecode (see Bytecode.hpp) and thrown away.
+
+class CRCodeBuilder;
+
+// Frame slot given to fields which aren't var locals
+constexpr unsigned int CR_NOT_LOCAL = 0xFFFFFFFF;
+
 // Abstract super-class for compiled actions
 class CRAction {
   public:
-    virtual bool Run() = 0;
+    virtual bool Emit(CRCodeBuilder& b) = 0;
     virtual void Finalize() {}
     virtual ~CRAction() {}
 };
@@ -18,10 +25,17 @@ class CRExpressionValue {
     CROperator _operator;
 
   protected:
-    virtual bool _evaluate(GMLType* output) = 0;
+    virtual bool _emit(CRCodeBuilder& b, unsigned int dst) = 0;
+    // Puts the value in "out", before unary operators, if it's known without running anything
+    virtual bool _constant(GMLType*) { return false; }
+    // Whether the value is always a real when it's run
+    virtual bool _isReal() { return false; }
 
   public:
-    bool Evaluate(GMLType* output);
+    bool Emit(CRCodeBuilder& b, unsigned int dst);
+    // Works the value out at compile time, unary operators and all, if that gives exactly what running it would
+    bool Fold(GMLType* out);
+    bool IsReal();
     virtual void Finalize() {}
     virtual ~CRExpressionValue() {}
 
@@ -38,7 +52,8 @@ class CRActionList {
 
   public:
     inline void Append(CRAction* a) { _actions.push_back(a); }
-    bool Run(unsigned int start = 0);
+    // If "starts" is given, the position of each action's code is put in it
+    bool Emit(CRCodeBuilder& b, std::vector<unsigned int>* starts = nullptr);
     virtual void Finalize();
 
     inline size_t Count() { return _actions.size(); }
@@ -51,7 +66,8 @@ class CRExpression {
 
   public:
     inline void Append(CRExpressionValue* a) { _values.push_back(a); }
-    bool Evaluate(GMLType* output);
+    bool Emit(CRCodeBuilder& b, unsigned int dst);
+    bool Fold(GMLType* out);
     inline std::vector<CRExpressionValue*>* GetValues() { return &_values; }
     virtual void Finalize();
 };
@@ -61,7 +77,7 @@ class CRExpression {
 
 class CRActionBindVars : public CRAction {
   public:
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     CRActionBindVars() {}
 };
 
@@ -72,13 +88,14 @@ class CRActionAssignmentField : public CRAction {
     CRExpression _deref;
     bool _hasDeref;
     CRExpression _expression;
-    bool _isLocal;
+    unsigned int _localSlot;
 
   public:
-    CRActionAssignmentField(unsigned int field, CRSetMethod method, CRExpression exp, bool isLocal) : _field(field), _method(method), _expression(exp), _hasDeref(false), _isLocal(isLocal) {}
-    CRActionAssignmentField(unsigned int field, CRSetMethod method, CRExpression deref, CRExpression exp, bool isLocal)
-        : _field(field), _method(method), _deref(deref), _expression(exp), _hasDeref(true), _isLocal(isLocal) {}
-    virtual bool Run() override;
+    CRActionAssignmentField(unsigned int field, CRSetMethod method, CRExpression exp, unsigned int localSlot)
+        : _field(field), _method(method), _expression(exp), _hasDeref(false), _localSlot(localSlot) {}
+    CRActionAssignmentField(unsigned int field, CRSetMethod method, CRExpression deref, CRExpression exp)
+        : _field(field), _method(method), _deref(deref), _expression(exp), _hasDeref(true), _localSlot(CR_NOT_LOCAL) {}
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _deref.Finalize();
         _expression.Finalize();
@@ -93,14 +110,14 @@ class CRActionAssignmentArray : public CRAction {
     CRExpression _deref;
     bool _hasDeref;
     CRExpression _expression;
-    bool _isLocal;
+    unsigned int _localSlot;
 
   public:
-    CRActionAssignmentArray(unsigned int field, CRSetMethod method, std::vector<CRExpression>& dimensions, CRExpression exp, bool isLocal)
-        : _field(field), _method(method), _expression(exp), _dimensions(dimensions), _hasDeref(false), _isLocal(isLocal) {}
-    CRActionAssignmentArray(unsigned int field, CRSetMethod method, std::vector<CRExpression>& dimensions, CRExpression deref, CRExpression exp, bool isLocal)
-        : _field(field), _method(method), _dimensions(dimensions), _deref(deref), _expression(exp), _hasDeref(true), _isLocal(isLocal) {}
-    virtual bool Run() override;
+    CRActionAssignmentArray(unsigned int field, CRSetMethod method, std::vector<CRExpression>& dimensions, CRExpression exp, unsigned int localSlot)
+        : _field(field), _method(method), _expression(exp), _dimensions(dimensions), _hasDeref(false), _localSlot(localSlot) {}
+    CRActionAssignmentArray(unsigned int field, CRSetMethod method, std::vector<CRExpression>& dimensions, CRExpression deref, CRExpression exp)
+        : _field(field), _method(method), _dimensions(dimensions), _deref(deref), _expression(exp), _hasDeref(true), _localSlot(CR_NOT_LOCAL) {}
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _deref.Finalize();
         _expression.Finalize();
@@ -124,7 +141,7 @@ class CRActionAssignmentInstanceVar : public CRAction {
         : _var(var), _method(method), _expression(exp), _dimensions(dimensions), _hasDeref(false) {}
     CRActionAssignmentInstanceVar(CRInstanceVar var, CRSetMethod method, std::vector<CRExpression>& dimensions, CRExpression deref, CRExpression exp)
         : _var(var), _method(method), _dimensions(dimensions), _deref(deref), _expression(exp), _hasDeref(true) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _deref.Finalize();
         _expression.Finalize();
@@ -144,7 +161,7 @@ class CRActionAssignmentGameVar : public CRAction {
   public:
     CRActionAssignmentGameVar(CRGameVar var, CRSetMethod method, std::vector<CRExpression>& dimensions, CRExpression expression)
         : _var(var), _method(method), _dimensions(dimensions), _expression(expression) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _expression.Finalize();
         for (CRExpression& exp : _dimensions) {
@@ -159,7 +176,7 @@ class CRActionBlock : public CRAction {
 
   public:
     CRActionBlock(CRActionList list) : _list(list) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override { _list.Finalize(); }
 };
 
@@ -170,7 +187,7 @@ class CRActionRunFunction : public CRAction {
 
   public:
     CRActionRunFunction(CRInternalFunction func, std::vector<CRExpression>& args) : _function(func), _args(args) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         for (CRExpression& exp : _args) {
             exp.Finalize();
@@ -185,7 +202,7 @@ class CRActionRunScript : public CRAction {
 
   public:
     CRActionRunScript(unsigned int id, std::vector<CRExpression>& args) : _scriptID(id), _args(args) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         for (CRExpression& exp : _args) {
             exp.Finalize();
@@ -201,7 +218,7 @@ class CRActionIfElse : public CRAction {
 
   public:
     CRActionIfElse(CRAction* i, CRAction* e, CRExpression exp) : _if(i), _else(e), _expression(exp) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _if->Finalize();
         delete _if;
@@ -220,7 +237,7 @@ class CRActionWith : public CRAction {
 
   public:
     CRActionWith(CRExpression exp, CRAction* code) : _expression(exp), _code(code) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _code->Finalize();
         delete _code;
@@ -235,7 +252,7 @@ class CRActionRepeat : public CRAction {
 
   public:
     CRActionRepeat(CRExpression exp, CRAction* code) : _expression(exp), _code(code) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _code->Finalize();
         delete _code;
@@ -250,7 +267,7 @@ class CRActionWhile : public CRAction {
 
   public:
     CRActionWhile(CRExpression exp, CRAction* code) : _expression(exp), _code(code) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _code->Finalize();
         delete _code;
@@ -267,7 +284,7 @@ class CRActionFor : public CRAction {
 
   public:
     CRActionFor(CRAction* init, CRExpression exp, CRAction* final, CRAction* code) : _initializer(init), _check(exp), _finalizer(final), _code(code) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _initializer->Finalize();
         delete _initializer;
@@ -286,7 +303,7 @@ class CRActionDoUntil : public CRAction {
 
   public:
     CRActionDoUntil(CRExpression exp, CRAction* code) : _expression(exp), _code(code) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _code->Finalize();
         delete _code;
@@ -309,7 +326,7 @@ class CRActionSwitch : public CRAction {
 
   public:
     CRActionSwitch(CRExpression exp, CRActionList actions, std::vector<SwitchCase>& offsets, unsigned int def) : _expression(exp), _actions(actions), _cases(offsets), _defaultOffset(def) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override {
         _expression.Finalize();
         _actions.Finalize();
@@ -322,19 +339,19 @@ class CRActionSwitch : public CRAction {
 class CRActionBreak : public CRAction {
   public:
     CRActionBreak() {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
 };
 
 class CRActionContinue : public CRAction {
   public:
     CRActionContinue() {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
 };
 
 class CRActionExit : public CRAction {
   public:
     CRActionExit() {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
 };
 
 class CRActionReturn : public CRAction {
@@ -343,7 +360,7 @@ class CRActionReturn : public CRAction {
 
   public:
     CRActionReturn(CRExpression exp) : _expression(exp) {}
-    virtual bool Run() override;
+    virtual bool Emit(CRCodeBuilder& b) override;
     virtual void Finalize() override { _expression.Finalize(); }
 };
 
@@ -362,7 +379,11 @@ class CRExpLiteral : public CRExpressionValue {
         _value.state = GMLTypeState::String;
         _value.sVal = s;
     }
-    bool _evaluate(GMLType* output) override;
+    bool _emit(CRCodeBuilder& b, unsigned int dst) override;
+    bool _constant(GMLType* out) override {
+        (*out) = _value;
+        return true;
+    }
 };
 
 class CRExpFunction : public CRExpressionValue {
@@ -372,7 +393,9 @@ class CRExpFunction : public CRExpressionValue {
 
   public:
     CRExpFunction(CRInternalFunction func, std::vector<CRExpression>& args) : _function(func), _args(args) {}
-    bool _evaluate(GMLType* output) override;
+    bool _emit(CRCodeBuilder& b, unsigned int dst) override;
+    bool _constant(GMLType* out) override;
+    bool _isReal() override;
     void Finalize() override {
         for (CRExpression& arg : _args) {
             arg.Finalize();
@@ -387,7 +410,7 @@ class CRExpScript : public CRExpressionValue {
 
   public:
     CRExpScript(unsigned int id, std::vector<CRExpression>& args) : _script(id), _args(args) {}
-    bool _evaluate(GMLType* output) override;
+    bool _emit(CRCodeBuilder& b, unsigned int dst) override;
     void Finalize() override {
         for (CRExpression& arg : _args) {
             arg.Finalize();
@@ -401,7 +424,8 @@ class CRExpNestedExpression : public CRExpressionValue {
 
   public:
     CRExpNestedExpression(CRExpression exp) : _expression(exp) {}
-    bool _evaluate(GMLType* output) override;
+    bool _emit(CRCodeBuilder& b, unsigned int dst) override;
+    bool _constant(GMLType* out) override { return _expression.Fold(out); }
     void Finalize() override { _expression.Finalize(); }
 };
 
@@ -410,12 +434,12 @@ class CRExpField : public CRExpressionValue {
     unsigned int _fieldNumber;
     CRExpression _deref;
     bool _hasDeref;
-    bool _isLocal;
+    unsigned int _localSlot;
 
   public:
-    CRExpField(unsigned int field, bool isLocal) : _fieldNumber(field), _hasDeref(false), _isLocal(isLocal) {}
-    CRExpField(unsigned int field, CRExpression deref, bool isLocal) : _fieldNumber(field), _deref(deref), _hasDeref(true), _isLocal(isLocal) {}
-    bool _evaluate(GMLType* output) override;
+    CRExpField(unsigned int field, unsigned int localSlot) : _fieldNumber(field), _hasDeref(false), _localSlot(localSlot) {}
+    CRExpField(unsigned int field, CRExpression deref) : _fieldNumber(field), _deref(deref), _hasDeref(true), _localSlot(CR_NOT_LOCAL) {}
+    bool _emit(CRCodeBuilder& b, unsigned int dst) override;
     void Finalize() override { _deref.Finalize(); }
 };
 
@@ -425,13 +449,14 @@ class CRExpArray : public CRExpressionValue {
     std::vector<CRExpression> _dimensions;
     CRExpression _deref;
     bool _hasDeref;
-    bool _isLocal;
+    unsigned int _localSlot;
 
   public:
-    CRExpArray(unsigned int field, std::vector<CRExpression>& dimensions, bool isLocal) : _fieldNumber(field), _dimensions(dimensions), _hasDeref(false), _isLocal(isLocal) {}
-    CRExpArray(unsigned int field, std::vector<CRExpression>& dimensions, CRExpression deref, bool isLocal)
-        : _fieldNumber(field), _dimensions(dimensions), _deref(deref), _hasDeref(true), _isLocal(isLocal) {}
-    bool _evaluate(GMLType* output) override;
+    CRExpArray(unsigned int field, std::vector<CRExpression>& dimensions, unsigned int localSlot)
+        : _fieldNumber(field), _dimensions(dimensions), _hasDeref(false), _localSlot(localSlot) {}
+    CRExpArray(unsigned int field, std::vector<CRExpression>& dimensions, CRExpression deref)
+        : _fieldNumber(field), _dimensions(dimensions), _deref(deref), _hasDeref(true), _localSlot(CR_NOT_LOCAL) {}
+    bool _emit(CRCodeBuilder& b, unsigned int dst) override;
     void Finalize() override {
         for (CRExpression& arg : _dimensions) {
             arg.Finalize();
@@ -450,7 +475,7 @@ class CRExpInstanceVar : public CRExpressionValue {
   public:
     CRExpInstanceVar(CRInstanceVar var, std::vector<CRExpression>& dimensions) : _var(var), _dimensions(dimensions), _hasDeref(false) {}
     CRExpInstanceVar(CRInstanceVar var, std::vector<CRExpression>& dimensions, CRExpression deref) : _var(var), _dimensions(dimensions), _deref(deref), _hasDeref(true) {}
-    bool _evaluate(GMLType* output) override;
+    bool _emit(CRCodeBuilder& b, unsigned int dst) override;
     void Finalize() override {
         for (CRExpression& arg : _dimensions) {
             arg.Finalize();
@@ -466,7 +491,7 @@ class CRExpGameVar : public CRExpressionValue {
 
   public:
     CRExpGameVar(CRGameVar var, std::vector<CRExpression>& dimensions) : _var(var), _dimensions(dimensions) {}
-    bool _evaluate(GMLType* output) override;
+    bool _emit(CRCodeBuilder& b, unsigned int dst) override;
     void Finalize() override {
         for (CRExpression& arg : _dimensions) {
             arg.Finalize();
@@ -1,9 +1,14 @@
 #include "Interpreter.hpp"
 #include "AssetManager.hpp"
+#include "Bytecode.hpp"
 #include "CRRuntime.hpp"
 #include "Compiled.hpp"
 #include "Constants.hpp"
 #include <algorithm>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
 
 namespace GM8Emulator {
     namespace Compiler {
@@ -31,23 +36,43 @@ namespace GM8Emulator {
         bool _TokenHasValue(const GM8Emulator::Compiler::Token& token, std::string t);
         void _SkipSemicolon(const GM8Emulator::Compiler::TokenList& list, unsigned int& pos);
 
+        // Every asset's index by name, filled in by IndexAssets(). It's only read while compiling, so no lock is needed.
+        std::unordered_map<std::string_view, unsigned int> _assetIndices;
+        // Scripts get their own table too, since a function call only ever means a script or an internal function.
+        std::unordered_map<std::string_view, unsigned int> _scriptIndices;
         bool _IsAsset(std::string_view& name, unsigned int* index = nullptr);
         bool _IsGMLConst(std::string_view& name, double* value = nullptr);
         bool _IsGameValue(std::string_view& name, CRGameVar* value = nullptr);
         bool _IsInstanceVar(std::string_view& name, CRInstanceVar* value = nullptr);
+        bool _IsScript(std::string_view& name, unsigned int* index = nullptr);
+        bool _IsInternalFunc(std::string_view& name, CRInternalFunction* value = nullptr);
 
         enum VarType { VARTYPE_INSTANCE, VARTYPE_FIELD, VARTYPE_GAME };
         VarType _getVarType(std::string_view& name, unsigned int* index = nullptr);
 
-        std::vector<std::string> _fieldNames;
+        // Field names are interned by every thread that's compiling, so this table is guarded by _fieldMutex.
+        // Names live in a deque so the views in _fieldNumbers stay valid as it grows.
+        std::deque<std::string> _fieldNames;
+        std::unordered_map<std::string_view, unsigned int> _fieldNumbers;
+        std::shared_mutex _fieldMutex;
         unsigned int _RegisterField(const std::string_view& name);
 
+        // Whether a registered name is really a field, rather than an asset or constant
+        bool _IsFieldName(unsigned int field);
+
         std::vector<const char*> _gameValueNames;
         std::vector<const char*> _instanceVarNames;
         std::vector<const char*> _internalFuncNames;
         std::vector<bool (*)(unsigned int, GMLType*, GMLType*)> _gmlFuncs;
+
+        // Built from the name lists above at the end of Init(), and never changed after that
+        std::unordered_map<std::string_view, unsigned int> _gameValueIndices;
+        std::unordered_map<std::string_view, unsigned int> _instanceVarIndices;
+        std::unordered_map<std::string_view, unsigned int> _internalFuncIndices;
+        void _IndexNames(const std::vector<const char*>& names, std::unordered_map<std::string_view, unsigned int>& indices);
+
         std::vector<char> _operatorPrecedence;
-        std::map<const char*, int> _gmlConsts = {{"ANSI_CHARSET", 0}, {"ARABIC_CHARSET", 178}, {"BALTIC_CHARSET", 186}, {"CHINESEBIG5_CHARSET", 136}, {"DEFAULT_CHARSET", 1},
+        std::unordered_map<std::string_view, int> _gmlConsts = {{"ANSI_CHARSET", 0}, {"ARABIC_CHARSET", 178}, {"BALTIC_CHARSET", 186}, {"CHINESEBIG5_CHARSET", 136}, {"DEFAULT_CHARSET", 1},
             {"EASTEUROPE_CHARSET", 238}, {"GB2312_CHARSET", 134}, {"GREEK_CHARSET", 161}, {"HANGEUL_CHARSET", 129}, {"HEBREW_CHARSET", 177}, {"JOHAB_CHARSET", 130}, {"MAC_CHARSET", 77},
             {"OEM_CHARSET", 255}, {"RUSSIAN_CHARSET", 204}, {"SHIFTJIS_CHARSET", 128}, {"SYMBOL_CHARSET", 2}, {"THAI_CHARSET", 222}, {"TURKISH_CHARSET", 162}, {"VIETNAMESE_CHARSET", 163}, {"all", -3},
             {"bm_add", 1}, {"bm_dest_alpha", 7}, {"bm_dest_color", 9}, {"bm_inv_dest_alpha", 8}, {"bm_inv_dest_color", 10}, {"bm_inv_src_alpha", 6}, {"bm_inv_src_color", 4}, {"bm_max", 2},
@@ -4719,23 +4744,91 @@ bool GM8Emulator::Compiler::Init(GlobalValues* globals) {
                 return false;
         }
     }
+    _IndexNames(_gameValueNames, _gameValueIndices);
+    _IndexNames(_instanceVarNames, _instanceVarIndices);
+    _IndexNames(_internalFuncNames, _internalFuncIndices);
     Runtime::Init(globals, _gmlFuncs);
     return true;
 }
 
+void GM8Emulator::Compiler::_IndexNames(const std::vector<const char*>& names, std::unordered_map<std::string_view, unsigned int>& indices) {
+    indices.clear();
+    indices.reserve(names.size());
+    for (unsigned int i = 0; i < names.size(); i++) indices.emplace(std::string_view(names[i]), i);
+}
+
 unsigned int GM8Emulator::Compiler::_RegisterField(const std::string_view& name) {
-    for (unsigned int i = 0; i < _fieldNames.size(); i++) {
-        if (name == _fieldNames[i]) {
-            return i;
-        }
+    {
+        std::shared_lock<std::shared_mutex> lock(_fieldMutex);
+        auto it = _fieldNumbers.find(name);
+        if (it != _fieldNumbers.end()) return it->second;
     }
+
+    std::unique_lock<std::shared_mutex> lock(_fieldMutex);
+    auto it = _fieldNumbers.find(name);
+    if (it != _fieldNumbers.end()) return it->second;
     _fieldNames.push_back(std::string(name));
-    return ( unsigned int )(_fieldNames.size() - 1);
+    unsigned int ix = ( unsigned int )(_fieldNames.size() - 1);
+    _fieldNumbers.emplace(std::string_view(_fieldNames.back()), ix);
+    return ix;
 }
 
-std::set<unsigned int> _locals;
+void GM8Emulator::Compiler::RegisterFields(const TokenList& list, std::vector<unsigned int>* instanceFields) {
+    std::vector<unsigned int> locals;
+    bool declaring = false;
+    for (unsigned int pos = 0; pos < list.tokens.size(); pos++) {
+        if (_TokenHasValue(list.tokens[pos], KeywordType::Var)) {
+            declaring = true;
+            continue;
+        }
+        if (list.tokens[pos].type != Token::token_type::Identifier) {
+            if (!_TokenHasValue(list.tokens[pos], SeparatorType::Comma)) declaring = false;
+            continue;
+        }
+        if (pos + 1 < list.tokens.size() && _TokenHasValue(list.tokens[pos + 1], SeparatorType::ParenLeft)) continue;
+
+        // This can register a few names which never get used as fields (asset names, constants) - that doesn't matter, as long as
+        // it's never missing one the compiler will need.
+        std::string_view name = list.tokens[pos].value.str;
+        if (_IsGameValue(name) || _IsInstanceVar(name)) continue;
+        unsigned int field = _RegisterField(name);
+        if (!instanceFields) continue;
+
+        if (declaring)
+            locals.push_back(field);
+        // Anything after a '.' belongs to some other instance
+        else if (pos == 0 || !_TokenHasValue(list.tokens[pos - 1], SeparatorType::Period))
+            instanceFields->push_back(field);
+    }
+    if (!instanceFields) return;
+
+    std::sort(instanceFields->begin(), instanceFields->end());
+    instanceFields->erase(std::unique(instanceFields->begin(), instanceFields->end()), instanceFields->end());
+    std::sort(locals.begin(), locals.end());
+    instanceFields->erase(std::remove_if(instanceFields->begin(), instanceFields->end(),
+                              [&](unsigned int field) { return std::binary_search(locals.begin(), locals.end(), field) || !_IsFieldName(field); }),
+        instanceFields->end());
+}
+
+bool GM8Emulator::Compiler::_IsFieldName(unsigned int field) {
+    std::shared_lock<std::shared_mutex> lock(_fieldMutex);
+    std::string_view name = _fieldNames[field];
+    return !_IsAsset(name) && !_IsGMLConst(name);
+}
+
+// Locals belong to the code object being compiled, and each thread compiles one at a time. Each one's frame slot is its position in here.
+thread_local std::vector<unsigned int> _locals;
 void GM8Emulator::Compiler::FlushLocals() { _locals.clear(); }
 
+void _DeclareLocal(unsigned int field) {
+    if (std::find(_locals.begin(), _locals.end(), field) == _locals.end()) _locals.push_back(field);
+}
+
+unsigned int _LocalSlot(unsigned int field) {
+    auto it = std::find(_locals.begin(), _locals.end(), field);
+    return (it == _locals.end() ? CR_NOT_LOCAL : static_cast<unsigned int>(it - _locals.begin()));
+}
+
 bool GM8Emulator::Compiler::Interpret(const TokenList& list, CRActionList* output) {
     unsigned int pos = 0;
     CRAction* action;
@@ -4753,6 +4846,21 @@ bool GM8Emulator::Compiler::Interpret(const TokenList& list, CRActionList* outpu
     return true;
 }
 
+bool GM8Emulator::Compiler::Compile(const TokenList& list, CRBytecode* output) {
+    CRActionList actions;
+    bool success = Interpret(list, &actions) && Lower(actions, output);
+    output->localFields = _locals;
+    actions.Finalize();
+    return success;
+}
+
+bool GM8Emulator::Compiler::CompileExpression(const TokenList& list, CRBytecode* output) {
+    CRExpression expression;
+    bool success = InterpretExpression(list, &expression) && Lower(expression, output);
+    expression.Finalize();
+    return success;
+}
+
 bool GetOperatorType(const GM8Emulator::Compiler::OperatorType& opType, CROperator* out) {
     switch (opType) {
         case GM8Emulator::Compiler::OperatorType::Add:
@@ -4980,29 +5088,17 @@ bool GM8Emulator::Compiler::InterpretExpression(const TokenList& list, CRExpress
                     (*pos)++;
 
                     // Check if this is a user script (scripts have precedence over internal functions)
-                    unsigned int scriptCount = AssetManager::GetScriptCount();
                     unsigned int s;
-                    for (s = 0; s < scriptCount; s++) {
-                        Script* scr = AssetManager::GetScript(s);
-                        if (!scr->exists) continue;
-                        if (identifier.compare(scr->name) == 0) {
-                            value = new CRExpScript(s, args);
-                            break;
-                        }
+                    CRInternalFunction f;
+                    if (_IsScript(identifier, &s)) {
+                        value = new CRExpScript(s, args);
                     }
-
-                    if (s == scriptCount) {
-                        // Check if this is an internal function
-                        unsigned int f;
-                        for (f = 0; f < _internalFuncNames.size(); f++) {
-                            if (identifier.compare(_internalFuncNames[f]) == 0) {
-                                value = new CRExpFunction(( CRInternalFunction )f, args);
-                                break;
-                            }
-                        }
-
-                        // Unrecognized function name?
-                        if (f == _internalFuncNames.size()) return false;
+                    else if (_IsInternalFunc(identifier, &f)) {
+                        value = new CRExpFunction(f, args);
+                    }
+                    else {
+                        // Unrecognized function name
+                        return false;
                     }
                 }
                 else {
@@ -5055,18 +5151,17 @@ bool GM8Emulator::Compiler::InterpretExpression(const TokenList& list, CRExpress
                                 }
                                 else {
                                     unsigned int fieldNumber = _RegisterField(identifier);
-                                    bool isLocal = _locals.count(fieldNumber);
                                     if (!dimensions.size()) {
                                         if (hasDeref)
-                                            value = new CRExpField(fieldNumber, derefCompiled, isLocal);
+                                            value = new CRExpField(fieldNumber, derefCompiled);
                                         else
-                                            value = new CRExpField(fieldNumber, isLocal);
+                                            value = new CRExpField(fieldNumber, _LocalSlot(fieldNumber));
                                     }
                                     else {
                                         if (hasDeref)
-                                            value = new CRExpArray(fieldNumber, dimensions, derefCompiled, isLocal);
+                                            value = new CRExpArray(fieldNumber, dimensions, derefCompiled);
                                         else
-                                            value = new CRExpArray(fieldNumber, dimensions, isLocal);
+                                            value = new CRExpArray(fieldNumber, dimensions, _LocalSlot(fieldNumber));
                                     }
                                 }
                             }
@@ -5224,11 +5319,11 @@ bool GM8Emulator::Compiler::_InterpretLine(const GM8Emulator::Compiler::TokenLis
 bool GM8Emulator::Compiler::_InterpretVar(const GM8Emulator::Compiler::TokenList& list, CRAction** output, unsigned int& pos) {
     pos++;
     if (list.tokens[pos].type != Token::token_type::Identifier) return false;
-    _locals.insert(_RegisterField(list.tokens[pos++].value.str));
+    _DeclareLocal(_RegisterField(list.tokens[pos++].value.str));
     while (_TokenHasValue(list.tokens[pos], SeparatorType::Comma)) {
         pos++;
         if (list.tokens[pos].type != Token::token_type::Identifier) return false;
-        _locals.insert(_RegisterField(list.tokens[pos++].value.str));
+        _DeclareLocal(_RegisterField(list.tokens[pos++].value.str));
     }
     _SkipSemicolon(list, pos);
     (*output) = new CRActionBindVars();
@@ -5534,18 +5629,17 @@ bool GM8Emulator::Compiler::_InterpretAssignment(const GM8Emulator::Compiler::To
     unsigned int index;
     switch (_getVarType(var, &index)) {
         case VarType::VARTYPE_FIELD: {
-            bool isLocal = _locals.count(index);
             if (dimensions.size()) {
                 if (hasDeref)
-                    (*output) = new CRActionAssignmentArray(index, method, dimensions, derefCompiled, exp, isLocal);
+                    (*output) = new CRActionAssignmentArray(index, method, dimensions, derefCompiled, exp);
                 else
-                    (*output) = new CRActionAssignmentArray(index, method, dimensions, exp, isLocal);
+                    (*output) = new CRActionAssignmentArray(index, method, dimensions, exp, _LocalSlot(index));
             }
             else {
                 if (hasDeref)
-                    (*output) = new CRActionAssignmentField(index, method, derefCompiled, exp, isLocal);
+                    (*output) = new CRActionAssignmentField(index, method, derefCompiled, exp);
                 else
-                    (*output) = new CRActionAssignmentField(index, method, exp, isLocal);
+                    (*output) = new CRActionAssignmentField(index, method, exp, _LocalSlot(index));
             }
             break;
         }
@@ -5587,22 +5681,17 @@ bool GM8Emulator::Compiler::_InterpretFunction(const GM8Emulator::Compiler::Toke
     _SkipSemicolon(list, pos);
 
     // Check if this is a user script (scripts have precedence over internal functions)
-    unsigned int scriptCount = AssetManager::GetScriptCount();
-    for (unsigned int s = 0; s < scriptCount; s++) {
-        Script* scr = AssetManager::GetScript(s);
-        if (!scr->exists) continue;
-        if (functionName.compare(scr->name) == 0) {
-            (*output) = new CRActionRunScript(s, args);
-            return true;
-        }
+    unsigned int s;
+    if (_IsScript(functionName, &s)) {
+        (*output) = new CRActionRunScript(s, args);
+        return true;
     }
 
     // Check if this is an internal function
-    for (unsigned int f = 0; f < _internalFuncNames.size(); f++) {
-        if (functionName.compare(_internalFuncNames[f]) == 0) {
-            (*output) = new CRActionRunFunction(( CRInternalFunction )f, args);
-            return true;
-        }
+    CRInternalFunction f;
+    if (_IsInternalFunc(functionName, &f)) {
+        (*output) = new CRActionRunFunction(f, args);
+        return true;
     }
 
     // Unrecognized function name
@@ -5672,99 +5761,63 @@ void GM8Emulator::Compiler::_SkipSemicolon(const GM8Emulator::Compiler::TokenLis
     }
 }
 
-bool GM8Emulator::Compiler::_IsAsset(std::string_view& name, unsigned int* index) {
-    // These are in order of precedence in the GM8 engine, since two assets can have the same name.
+void GM8Emulator::Compiler::IndexAssets() {
+    _assetIndices.clear();
+    _scriptIndices.clear();
+    auto add = [](const char* name, unsigned int index) {
+        // Two assets can have the same name, so the first one in order of precedence has to be the one that's kept
+        if (name) _assetIndices.emplace(std::string_view(name), index);
+    };
+
+    // These are in order of precedence in the GM8 engine
     unsigned int i;
     for (i = 0; i < AssetManager::GetObjectCount(); i++) {
-        if (AssetManager::GetObject(i)->exists) {
-            if (!name.compare(AssetManager::GetObject(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetObject(i)->exists) add(AssetManager::GetObject(i)->name, i);
     }
     for (i = 0; i < AssetManager::GetSpriteCount(); i++) {
-        if (AssetManager::GetSprite(i)->exists) {
-            if (!name.compare(AssetManager::GetSprite(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetSprite(i)->exists) add(AssetManager::GetSprite(i)->name, i);
     }
     for (i = 0; i < AssetManager::GetSoundCount(); i++) {
-        if (AssetManager::GetSound(i)->exists) {
-            if (!name.compare(AssetManager::GetSound(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetSound(i)->exists) add(AssetManager::GetSound(i)->name, i);
     }
     for (i = 0; i < AssetManager::GetBackgroundCount(); i++) {
-        if (AssetManager::GetBackground(i)->exists) {
-            if (!name.compare(AssetManager::GetBackground(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetBackground(i)->exists) add(AssetManager::GetBackground(i)->name, i);
     }
     for (i = 0; i < AssetManager::GetPathCount(); i++) {
-        if (AssetManager::GetPath(i)->exists) {
-            if (!name.compare(AssetManager::GetPath(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetPath(i)->exists) add(AssetManager::GetPath(i)->name, i);
     }
     for (i = 0; i < AssetManager::GetFontCount(); i++) {
-        if (AssetManager::GetFont(i)->exists) {
-            if (!name.compare(AssetManager::GetFont(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetFont(i)->exists) add(AssetManager::GetFont(i)->name, i);
     }
     for (i = 0; i < AssetManager::GetTimelineCount(); i++) {
-        if (AssetManager::GetTimeline(i)->exists) {
-            if (!name.compare(AssetManager::GetTimeline(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetTimeline(i)->exists) add(AssetManager::GetTimeline(i)->name, i);
     }
     for (i = 0; i < AssetManager::GetScriptCount(); i++) {
         if (AssetManager::GetScript(i)->exists) {
-            if (!name.compare(AssetManager::GetScript(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
+            add(AssetManager::GetScript(i)->name, i);
+            if (AssetManager::GetScript(i)->name) _scriptIndices.emplace(std::string_view(AssetManager::GetScript(i)->name), i);
         }
     }
     for (i = 0; i < AssetManager::GetRoomCount(); i++) {
-        if (AssetManager::GetRoom(i)->exists) {
-            if (!name.compare(AssetManager::GetRoom(i)->name)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetRoom(i)->exists) add(AssetManager::GetRoom(i)->name, i);
     }
     for (i = 0; i < AssetManager::GetTriggerCount(); i++) {
-        if (AssetManager::GetTrigger(i)->exists) {
-            if (!name.compare(AssetManager::GetTrigger(i)->constantName)) {
-                if (index) (*index) = i;
-                return true;
-            }
-        }
+        if (AssetManager::GetTrigger(i)->exists) add(AssetManager::GetTrigger(i)->constantName, i);
     }
+}
 
-    return false;
+bool GM8Emulator::Compiler::_IsAsset(std::string_view& name, unsigned int* index) {
+    auto asset = _assetIndices.find(name);
+    if (asset == _assetIndices.end()) return false;
+    if (index) (*index) = asset->second;
+    return true;
 }
 
 bool GM8Emulator::Compiler::_IsGMLConst(std::string_view& name, double* value) {
-    for (const auto& c : _gmlConsts) {
-        if (name.compare(c.first) == 0) {
-            if (value) (*value) = static_cast<double>(c.second);
-            return true;
-        }
+    auto c = _gmlConsts.find(name);
+    if (c != _gmlConsts.end()) {
+        if (value) (*value) = static_cast<double>(c->second);
+        return true;
     }
     if (name == "pi") {  // LUL
         if (value) (*value) = GML_PI;
@@ -5774,40 +5827,46 @@ bool GM8Emulator::Compiler::_IsGMLConst(std::string_view& name, double* value) {
 }
 
 bool GM8Emulator::Compiler::_IsGameValue(std::string_view& name, CRGameVar* value) {
-    for (unsigned int i = 0; i < _gameValueNames.size(); i++) {
-        if (name.compare(_gameValueNames[i]) == 0) {
-            if (value) (*value) = static_cast<CRGameVar>(i);
-            return true;
-        }
-    }
-    return false;
+    auto var = _gameValueIndices.find(name);
+    if (var == _gameValueIndices.end()) return false;
+    if (value) (*value) = static_cast<CRGameVar>(var->second);
+    return true;
 }
 
 bool GM8Emulator::Compiler::_IsInstanceVar(std::string_view& name, CRInstanceVar* value) {
-    for (unsigned int i = 0; i < _instanceVarNames.size(); i++) {
-        if (name.compare(_instanceVarNames[i]) == 0) {
-            if (value) (*value) = static_cast<CRInstanceVar>(i);
-            return true;
-        }
-    }
-    return false;
+    auto var = _instanceVarIndices.find(name);
+    if (var == _instanceVarIndices.end()) return false;
+    if (value) (*value) = static_cast<CRInstanceVar>(var->second);
+    return true;
+}
+
+bool GM8Emulator::Compiler::_IsScript(std::string_view& name, unsigned int* index) {
+    auto script = _scriptIndices.find(name);
+    if (script == _scriptIndices.end()) return false;
+    if (index) (*index) = script->second;
+    return true;
+}
+
+bool GM8Emulator::Compiler::_IsInternalFunc(std::string_view& name, CRInternalFunction* value) {
+    auto func = _internalFuncIndices.find(name);
+    if (func == _internalFuncIndices.end()) return false;
+    if (value) (*value) = static_cast<CRInternalFunction>(func->second);
+    return true;
 }
 
 GM8Emulator::Compiler::VarType GM8Emulator::Compiler::_getVarType(std::string_view& name, unsigned int* index) {
     // Game values have highest precedence
-    for (unsigned int i = 0; i < _gameValueNames.size(); i++) {
-        if (name.compare(_gameValueNames[i]) == 0) {
-            if (index) (*index) = i;
-            return VARTYPE_GAME;
-        }
+    CRGameVar gameVar;
+    if (_IsGameValue(name, &gameVar)) {
+        if (index) (*index) = gameVar;
+        return VARTYPE_GAME;
     }
 
     // Next, instance variables
-    for (unsigned int i = 0; i < _instanceVarNames.size(); i++) {
-        if (name.compare(_instanceVarNames[i]) == 0) {
-            if (index) (*index) = i;
-            return VARTYPE_INSTANCE;
-        }
+    CRInstanceVar instanceVar;
+    if (_IsInstanceVar(name, &instanceVar)) {
+        if (index) (*index) = instanceVar;
+        return VARTYPE_INSTANCE;
     }
 
     // If none of the above, it must be a field, let's register it
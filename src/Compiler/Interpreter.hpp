@@ -1,18 +1,34 @@
 #pragma once
 
 #include "Tokenizer.hxx"
+#include <vector>
 
 class CRActionList;
 class CRExpression;
+struct CRBytecode;
 struct GlobalValues;
 
 namespace GM8Emulator {
     namespace Compiler {
         bool Init(GlobalValues* globals);
 
+        // Indexes the names of all the game's assets, so that code can refer to them. Call once all the assets are loaded,
+        // and before compiling anything.
+        void IndexAssets();
+
         bool Interpret(const TokenList& list, CRActionList* output);
         bool InterpretExpression(const TokenList& list, CRExpression* output, unsigned int* pos = nullptr, char precedence = 5, char lowestAllowedPrec = 0);
 
+        // Parses code, then lowers it to bytecode for the runtime. The parse tree is thrown away afterwards.
+        bool Compile(const TokenList& list, CRBytecode* output);
+        bool CompileExpression(const TokenList& list, CRBytecode* output);
+
+        // Registers the names of all the fields this code might use. Field numbers are handed out in the order names are first registered,
+        // by whichever thread gets there first, so they're only meaningful within one run. Safe to call from any thread.
+        // If instanceFields is given, it's filled with the sorted numbers of the fields the code uses on its own instance.
+        void RegisterFields(const TokenList& list, std::vector<unsigned int>* instanceFields = nullptr);
+
+        // Forgets the locals declared by the code this thread has just compiled. Call after each Compile() or CompileExpression().
         void FlushLocals();
     };
 };
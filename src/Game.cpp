@@ -1,18 +1,35 @@
 #include "Game.hpp"
 #include "CodeActionManager.hpp"
 #include "CodeRunner.hpp"
+#include "GameCache.hpp"
 #include "GamePrivateGlobals.hpp"
 #include "InputHandler.hpp"
 #include "Instance.hpp"
+#include "MappedFile.hpp"
+#include "Movement.hpp"
 #include "Renderer.hpp"
 #include "StreamUtil.hpp"
-#include <fstream>
-#include <new>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
 #include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
 #include <zlib.h>
 
 constexpr unsigned int ZLIB_BUF_START = 65536;
 
+// Memory-map game.exe with copy-on-write pages instead of reading all of it into a buffer, where the platform supports it
+constexpr bool MAP_GAME_FILE = true;
+
+// Keep a cache of everything decoded from game.exe next to it, so later launches can skip decrypting and inflating it
+constexpr bool USE_GAME_CACHE = true;
+constexpr const char* GAME_CACHE_EXTENSION = ".cache";
+
+// Only compile GML code the first time it runs, rather than compiling all of it during GameLoad
+constexpr bool LAZY_COMPILATION = true;
+
 #pragma region Helper functions for parsing the filestream - no need for these to be member functions.
 
 // YYG's implementation of Crc32
@@ -233,6 +250,176 @@ bool InflateBlock(unsigned char* pStream, unsigned int* pPos, unsigned char** pO
     return true;
 }
 
+// Skips "skip" bytes from pPos and reads the dword after them. Returns false, and doesn't move pPos, if that would run off the end of the stream.
+bool _scanDword(const unsigned char* pStream, size_t pStreamLength, unsigned int* pPos, unsigned int skip, unsigned int* pOut) {
+    size_t pos = static_cast<size_t>(*pPos) + skip;
+    if (pos > pStreamLength || pStreamLength - pos < 4) return false;
+    (*pPos) = static_cast<unsigned int>(pos);
+    (*pOut) = ReadDword(pStream, pPos);
+    return true;
+}
+
+// Records "count" consecutive blocks of the given kind, starting at pPos. Returns false if any of them runs off the end of the stream.
+bool _scanBlocks(const unsigned char* pStream, size_t pStreamLength, unsigned int* pPos, AssetKind kind, unsigned int count, std::vector<AssetBlock>& blocks) {
+    // Every block has at least its length dword, so a count bigger than that can't be right - and mustn't be used to size anything
+    if (count > (pStreamLength - (*pPos)) / 4) return false;
+    for (; count > 0; count--) {
+        AssetBlock block;
+        block.kind = kind;
+        block.pos = *pPos;
+        if (!_scanDword(pStream, pStreamLength, pPos, 0, &block.length)) return false;
+        if (block.length > pStreamLength - (*pPos)) return false;
+        (*pPos) += block.length;
+        blocks.push_back(block);
+    }
+    return true;
+}
+
+// First loading pass: walks the data paragraphs from the triggers list up to and including the game information block, and records the
+// position of every compressed block in resource order without inflating anything. pPos must point at the start of the triggers list.
+// Every read is bounds-checked, since the counts and lengths come straight from the file. Returns false if anything doesn't fit.
+bool ScanAssetBlocks(const unsigned char* pStream, size_t pStreamLength, unsigned int pos, std::vector<AssetBlock>& blocks) {
+    const AssetKind assetLists[] = { AssetKind::Sound, AssetKind::Sprite, AssetKind::Background, AssetKind::Path, AssetKind::Script, AssetKind::Font, AssetKind::Timeline, AssetKind::Object, AssetKind::Room };
+    if (pos > pStreamLength) return false;
+    unsigned int count;
+
+    // Triggers
+    if (!_scanDword(pStream, pStreamLength, &pos, 4, &count)) return false;
+    if (!_scanBlocks(pStream, pStreamLength, &pos, AssetKind::Trigger, count, blocks)) return false;
+
+    // Constants are stored uncompressed, so just skip over them. Each is a name and a value, both with a length dword in front.
+    if (!_scanDword(pStream, pStreamLength, &pos, 4, &count)) return false;
+    if (count > (pStreamLength - pos) / 8) return false;
+    for (unsigned int i = 0; i < count * 2; i++) {
+        unsigned int length;
+        if (!_scanDword(pStream, pStreamLength, &pos, 0, &length)) return false;
+        if (length > pStreamLength - pos) return false;
+        pos += length;
+    }
+
+    for (AssetKind kind : assetLists) {
+        if (!_scanDword(pStream, pStreamLength, &pos, 4, &count)) return false;
+        if (!_scanBlocks(pStream, pStreamLength, &pos, kind, count, blocks)) return false;
+    }
+
+    // Last instance and tile IDs, then the included files
+    if (!_scanDword(pStream, pStreamLength, &pos, 12, &count)) return false;
+    if (!_scanBlocks(pStream, pStreamLength, &pos, AssetKind::IncludeFile, count, blocks)) return false;
+
+    // Game information
+    if (pStreamLength - pos < 4) return false;
+    pos += 4;
+    return _scanBlocks(pStream, pStreamLength, &pos, AssetKind::GameInfo, 1, blocks);
+}
+
+// Second loading pass: inflates the scanned blocks on a pool of worker threads, while the loader consumes them in resource order with Next().
+// Workers never run more than a fixed window of blocks ahead of the consumer, so only a handful of inflated blocks are held at any time.
+// With no spare hardware threads, each block is simply inflated when it's asked for. Blocks loaded from the game cache are handed out as they are.
+class BlockInflater {
+  private:
+    unsigned char* _stream;
+    std::vector<AssetBlock>& _blocks;
+    bool _cached;
+    GameCache::Writer* _cacheWriter;
+    std::vector<std::thread> _workers;
+    std::mutex _mutex;
+    std::condition_variable _inflated;
+    std::condition_variable _consumed;
+    size_t _nextJob;
+    size_t _cursor;
+    size_t _window;
+    bool _stop;
+
+    void _inflate(AssetBlock& block) {
+        unsigned int pos = block.pos;
+        unsigned int bufferSize = ZLIB_BUF_START;
+        unsigned char* buffer = ( unsigned char* )malloc(bufferSize);
+        if (InflateBlock(_stream, &pos, &buffer, &bufferSize, &block.size)) {
+            block.data = buffer;
+        }
+        else {
+            free(buffer);
+            block.failed = true;
+        }
+    }
+
+    void _work() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true) {
+            _consumed.wait(lock, [this] { return _stop || (_nextJob < _blocks.size() && _nextJob < _cursor + _window); });
+            if (_stop) return;
+
+            AssetBlock& block = _blocks[_nextJob++];
+            lock.unlock();
+            _inflate(block);
+            lock.lock();
+            block.done = true;
+            _inflated.notify_all();
+        }
+    }
+
+  public:
+    // If "cached" is set, the blocks are already inflated and belong to someone else. Otherwise, if there's a cache writer, each block is added to it
+    // once the consumer is done with it.
+    BlockInflater(unsigned char* pStream, std::vector<AssetBlock>& blocks, bool cached, GameCache::Writer* cacheWriter)
+        : _stream(pStream), _blocks(blocks), _cached(cached), _cacheWriter(cacheWriter), _nextJob(0), _cursor(0), _stop(false) {
+        unsigned int threads = std::thread::hardware_concurrency();
+        _window = threads * 4;
+        if (threads > 1 && !cached) {
+            for (unsigned int i = 0; i < threads; i++) {
+                _workers.emplace_back(&BlockInflater::_work, this);
+            }
+        }
+    }
+
+    ~BlockInflater() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stop = true;
+        }
+        _consumed.notify_all();
+        for (std::thread& worker : _workers) worker.join();
+        if (_cacheWriter && _cursor > 0 && _cursor == _blocks.size()) _cacheWriter->AddBlock(_blocks[_cursor - 1]);
+        if (!_cached) {
+            for (AssetBlock& block : _blocks) {
+                free(block.data);
+                block.data = nullptr;
+            }
+        }
+    }
+
+    // Gets the next block in resource order, which must be of the given kind and start at pPos. pPos is advanced past the block.
+    // The data belongs to the inflater and stays valid until the next call. Returns false if the block is missing or couldn't be inflated.
+    bool Next(AssetKind kind, unsigned int* pPos, unsigned char** pData, unsigned int* pSize) {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        // The consumer is done with the previous block now
+        if (_cursor > 0 && !_cached) {
+            if (_cacheWriter) _cacheWriter->AddBlock(_blocks[_cursor - 1]);
+            free(_blocks[_cursor - 1].data);
+            _blocks[_cursor - 1].data = nullptr;
+        }
+        if (_cursor >= _blocks.size() || _blocks[_cursor].kind != kind || _blocks[_cursor].pos != (*pPos)) return false;
+
+        AssetBlock& block = _blocks[_cursor++];
+        if (_workers.empty()) {
+            if (!block.done) {
+                _inflate(block);
+                block.done = true;
+            }
+        }
+        else {
+            _consumed.notify_all();
+            _inflated.wait(lock, [&block] { return block.done; });
+        }
+
+        (*pPos) = block.pos + 4 + block.length;
+        (*pData) = block.data;
+        (*pSize) = block.size;
+        return !block.failed;
+    }
+};
+
 #pragma endregion
 
 #pragma region Global extern definitions
@@ -249,6 +436,9 @@ void GameInit() {
     _info.gameInfo = NULL;
     RInit();
     InstanceList::Init();
+#if _DEBUG
+    MovementUnitTest(std::cout);
+#endif
     _roomOrder = NULL;
     _lastUsedRoomSpeed = 0;
 }
@@ -281,73 +471,87 @@ bool GameLoad(const char* pFilename) {
     if (!CodeManager::Init(&_globals)) {
         return false;
     }
+    CodeManager::SetLazyCompilation(LAZY_COMPILATION);
 
-    // Load the entirety of the file into a memory buffer
-    // fs::path(pFilename)
-    std::ifstream ifs(pFilename, std::ios::binary | std::ios::ate);
-
-    if (!ifs.is_open() || ifs.bad()) {
+    // Open the file - this maps it into memory if we can, otherwise the entirety of it is read into a memory buffer
+    MappedFile gameFile;
+    if (!MapFile(pFilename, &gameFile, MAP_GAME_FILE)) {
         // This really should be more verbose.
-        // Failed to open file.
+        // Failed to open file, or to allocate memory for it.
         return false;
     }
 
-    std::streamsize file_size = ifs.tellg();
-    unsigned char* buffer;
+    unsigned char* buffer = gameFile.data;
+    size_t file_size = gameFile.size;
+    unsigned int pos;
+    int version = 0;
 
-    try {
-        buffer = new unsigned char[static_cast<unsigned int>(file_size)];
-    }
-    catch (const std::bad_alloc&) {
-        // This really should be more verbose.
-        // Failed to allocate memory.
-        return false;
+    // See if we've already decoded this game before. If so, the cache replaces game.exe as the file we're reading from, and holds all the asset blocks.
+    std::string cacheFilename = std::string(pFilename) + GAME_CACHE_EXTENSION;
+    GameCache::Key gameKey = {};
+    unsigned long long gameHash = 0;
+    std::vector<AssetBlock> blocks;
+    bool cached = false;
+    if (USE_GAME_CACHE) {
+        gameKey = GameCache::MakeKey(pFilename, gameFile.data, gameFile.size);
+
+        MappedFile cacheFile;
+        unsigned char* stream;
+        unsigned int streamLength;
+        if (GameCache::Open(cacheFilename.c_str(), gameKey, gameFile.data, &cacheFile, &version, &stream, &streamLength, blocks)) {
+            printf("Loading from game cache\n");
+            UnmapFile(&gameFile);
+            gameFile = cacheFile;
+            buffer = stream;
+            file_size = streamLength;
+            pos = 0;
+            cached = true;
+        }
+        else {
+            // We're about to decrypt the game in place, so this is the last chance to hash it for the new cache
+            gameHash = GameCache::Hash(gameFile.data, gameFile.size);
+        }
     }
 
-    ifs.seekg(std::ios::beg);
-    ifs.read(reinterpret_cast<char*>(buffer), file_size);
-    ifs.close();
-
-    // Check if this is a valid exe
+    if (!cached) {
+        // Check if this is a valid exe
 
-    if (static_cast<unsigned int>(file_size) < 0x1B) {
-        // Invalid file, too small to be an exe
-        delete[] buffer;
-        return false;
-    }
-
-    if (!(buffer[0] == 'M' && buffer[1] == 'Z')) {
-        // Invalid file, not an exe
-        delete[] buffer;
-        return false;
-    }
+        if (static_cast<unsigned int>(file_size) < 0x1B) {
+            // Invalid file, too small to be an exe
+            UnmapFile(&gameFile);
+            return false;
+        }
 
-    // Find game version by searching for headers
+        if (!(buffer[0] == 'M' && buffer[1] == 'Z')) {
+            // Invalid file, not an exe
+            UnmapFile(&gameFile);
+            return false;
+        }
 
-    unsigned int pos;
-    int version = 0;
+        // Find game version by searching for headers
 
-    // GM8.0 header
-    pos = 2000000;
-    if (ReadDword(buffer, &pos) == 1234321) {
-        version = 800;
-        pos += 8;
-    }
-    else {
-        // GM8.1 header
-        pos = 3800004;
-        for (int i = 0; i < 1024; i++) {
-            if ((ReadDword(buffer, &pos) & 0xFF00FF00) == 0xF7000000) {
-                if ((ReadDword(buffer, &pos) & 0x00FF00FF) == 0x00140067) {
+        // GM8.0 header
+        pos = 2000000;
+        if (ReadDword(buffer, &pos) == 1234321) {
+            version = 800;
+            pos += 8;
+        }
+        else {
+            // GM8.1 header
+            pos = 3800004;
+            for (int i = 0; i < 1024; i++) {
+                if ((ReadDword(buffer, &pos) & 0xFF00FF00) == 0xF7000000) {
+                    if ((ReadDword(buffer, &pos) & 0x00FF00FF) == 0x00140067) {
 
-                    version = 810;
-                    Decrypt81(buffer, static_cast<unsigned int>(file_size), &pos);
+                        version = 810;
+                        Decrypt81(buffer, static_cast<unsigned int>(file_size), &pos);
 
-                    pos += 16;
-                    break;
-                }
-                else {
-                    pos -= 4;
+                        pos += 16;
+                        break;
+                    }
+                    else {
+                        pos -= 4;
+                    }
                 }
             }
         }
@@ -356,7 +560,7 @@ bool GameLoad(const char* pFilename) {
     if (!version) {
         printf("This is not a GameMaker 8 or 8.1 game!\n");
         // No game version found
-        delete[] buffer;
+        UnmapFile(&gameFile);
         return false;
     }
 
@@ -368,12 +572,13 @@ bool GameLoad(const char* pFilename) {
     unsigned int outputSize;
 
     // Settings Data Chunk
+    unsigned int streamStart = pos;
     pos += 4;
     if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
         // Error reading settings block
         printf("Error reading settings block\n");
         free(data);
-        delete[] buffer;
+        UnmapFile(&gameFile);
         return false;
     }
     else {
@@ -414,7 +619,7 @@ bool GameLoad(const char* pFilename) {
                     // Error reading backdata
                     free(loadingData);
                     free(data);
-                    delete[] buffer;
+                    UnmapFile(&gameFile);
                     return false;
                 }
 
@@ -427,7 +632,7 @@ bool GameLoad(const char* pFilename) {
                     // Error reading frontdata
                     free(loadingData);
                     free(data);
-                    delete[] buffer;
+                    UnmapFile(&gameFile);
                     return false;
                 }
 
@@ -448,7 +653,7 @@ bool GameLoad(const char* pFilename) {
                 // Error reading custom load image
                 free(imageData);
                 free(data);
-                delete[] buffer;
+                UnmapFile(&gameFile);
                 return false;
             }
 
@@ -474,20 +679,23 @@ bool GameLoad(const char* pFilename) {
             settings.errorOnUninitialization = true;
         }
     }
+    unsigned int settingsEnd = pos;
     printf("Settings\n");
     // Skip over the D3D wrapper
     pos += ReadDword(buffer, &pos);
     pos += ReadDword(buffer, &pos);
     printf("no d3d_ :(\n");
     // There's yet another encryption layer on the rest of the data paragraphs.
-    if (!DecryptData(buffer, &pos)) {
+    if (!cached && !DecryptData(buffer, &pos)) {
         // Error decrypting
         printf("error decrypting\n");
         free(data);
-        delete[] buffer;
+        UnmapFile(&gameFile);
         return false;
     }
 
+    unsigned int dataStart = pos;
+
     // Garbage fields
     pos += (ReadDword(buffer, &pos) + 6) * 4;
 
@@ -578,9 +786,11 @@ bool GameLoad(const char* pFilename) {
             charTable[DX + 0x100] = i + 1;
         }
 
-        // File decryption - decrypting data block
-        for (unsigned int i = dataPos + 1; i < pos; i++) {
-            buffer[i] = charTable[buffer[i] + 0x100];
+        // File decryption - decrypting data block (the cache already has it decrypted)
+        if (!cached) {
+            for (unsigned int i = dataPos + 1; i < pos; i++) {
+                buffer[i] = charTable[buffer[i] + 0x100];
+            }
         }
 
         // Read the files
@@ -588,7 +798,7 @@ bool GameLoad(const char* pFilename) {
             if (!InflateBlock(buffer, &dataPos, &data, &dataLength, &outputSize)) {
                 // Error reading file
                 free(data);
-                delete[] buffer;
+                UnmapFile(&gameFile);
                 free(charTable);
                 return true;
             }
@@ -599,6 +809,23 @@ bool GameLoad(const char* pFilename) {
         }
     }
     free(charTable);
+    free(data);
+
+    // Every remaining asset is in its own compressed block. Find them all first, so they can be inflated in parallel while we parse them in order.
+    // If we're loading from the cache, they're all there already. Otherwise, write them into a new cache as they get parsed.
+    GameCache::Writer cacheWriter;
+    if (!cached) {
+        if (!ScanAssetBlocks(buffer, file_size, pos, blocks)) {
+            // Asset blocks don't fit in the file
+            printf("Error scanning asset blocks\n");
+            UnmapFile(&gameFile);
+            return false;
+        }
+        if (USE_GAME_CACHE && !cacheWriter.Begin(cacheFilename.c_str())) {
+            printf("Couldn't create game cache\n");
+        }
+    }
+    BlockInflater* inflater = new BlockInflater(buffer, blocks, cached, cached ? nullptr : &cacheWriter);
 
 
     // Triggers
@@ -610,10 +837,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveTriggers(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Trigger, &pos, &data, &outputSize)) {
             // Error reading trigger
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -655,10 +882,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveSounds(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Sound, &pos, &data, &outputSize)) {
             // Error reading sound
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -701,10 +928,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveSprites(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Sprite, &pos, &data, &outputSize)) {
             // Error reading sprite
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -737,20 +964,23 @@ bool GameLoad(const char* pFilename) {
 
                 if (pixelDataLength != (frameW * frameH * 4)) {
                     // This should never happen
-                    free(data);
-                    delete[] buffer;
+                    delete inflater;
+                    UnmapFile(&gameFile);
                     return false;
                 }
 
-                // Convert BGRA to RGBA
+                // Convert BGRA to RGBA (the cache already has it converted)
                 unsigned char* pixelData = (data + dataPos);
                 unsigned int pixelDataEnd = (dataPos + pixelDataLength);
-                unsigned char tmp;
-                for (; dataPos < pixelDataEnd; dataPos += 4) {
-                    tmp = data[dataPos];
-                    data[dataPos] = data[dataPos + 2];
-                    data[dataPos + 2] = tmp;
+                if (!cached) {
+                    unsigned char tmp;
+                    for (; dataPos < pixelDataEnd; dataPos += 4) {
+                        tmp = data[dataPos];
+                        data[dataPos] = data[dataPos + 2];
+                        data[dataPos + 2] = tmp;
+                    }
                 }
+                dataPos = pixelDataEnd;
 
                 sprite->frames[i] = RMakeImage(frameW, frameH, sprite->originX, sprite->originY, pixelData);
 
@@ -820,10 +1050,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveBackgrounds(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Background, &pos, &data, &outputSize)) {
             // Error reading background
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -844,14 +1074,17 @@ bool GameLoad(const char* pFilename) {
             unsigned int len = ReadDword(data, &dataPos);
             unsigned int dStart = dataPos;
 
-            // Convert RGBA to BGRA
+            // Convert RGBA to BGRA (the cache already has it converted)
             unsigned int pixelDataEnd = dataPos + len;
-            unsigned char tmp;
-            for (; dataPos < pixelDataEnd; dataPos += 4) {
-                tmp = data[dataPos];
-                data[dataPos] = data[dataPos + 2];
-                data[dataPos + 2] = tmp;
+            if (!cached) {
+                unsigned char tmp;
+                for (; dataPos < pixelDataEnd; dataPos += 4) {
+                    tmp = data[dataPos];
+                    data[dataPos] = data[dataPos + 2];
+                    data[dataPos + 2] = tmp;
+                }
             }
+            dataPos = pixelDataEnd;
 
             background->image = RMakeImage(background->width, background->height, 0, 0, (data + dStart));
         }
@@ -865,10 +1098,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReservePaths(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Path, &pos, &data, &outputSize)) {
             // Error reading path
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -906,10 +1139,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveScripts(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Script, &pos, &data, &outputSize)) {
             // Error reading script
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -937,10 +1170,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveFonts(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Font, &pos, &data, &outputSize)) {
             // Error reading font
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -978,8 +1211,8 @@ bool GameLoad(const char* pFilename) {
         unsigned int dlen = ReadDword(data, &dataPos);
         if (w * h != dlen) {
             // Bad font data
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -1004,10 +1237,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveTimelines(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Timeline, &pos, &data, &outputSize)) {
             // Error reading timeline
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -1034,12 +1267,13 @@ bool GameLoad(const char* pFilename) {
             for (unsigned int j = 0; j < timeline->moments[index].actionCount; j++) {
                 if (!CodeActionManager::Read(data, &dataPos, timeline->moments[index].actions + j)) {
                     // Error reading action
-                    free(data);
-                    delete[] buffer;
+                    delete inflater;
+                    UnmapFile(&gameFile);
                     return false;
                 }
             }
         }
+        timeline->IndexMoments();
     }
 
 
@@ -1051,10 +1285,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveObjects(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Object, &pos, &data, &outputSize)) {
             // Error reading object
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -1094,8 +1328,8 @@ bool GameLoad(const char* pFilename) {
                     if (!CodeActionManager::Read(data, &dataPos, e.actions + j)) {
                         // Error reading action
                         delete[] e.actions;
-                        free(data);
-                        delete[] buffer;
+                        delete inflater;
+                        UnmapFile(&gameFile);
                         return false;
                     }
                 }
@@ -1116,10 +1350,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveRooms(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::Room, &pos, &data, &outputSize)) {
             // Error reading room
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -1229,10 +1463,10 @@ bool GameLoad(const char* pFilename) {
     AssetManager::ReserveIncludeFiles(count);
     for (; count > 0; count--) {
 
-        if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+        if (!inflater->Next(AssetKind::IncludeFile, &pos, &data, &outputSize)) {
             // Error reading whatever this is
-            free(data);
-            delete[] buffer;
+            delete inflater;
+            UnmapFile(&gameFile);
             return false;
         }
 
@@ -1268,10 +1502,10 @@ bool GameLoad(const char* pFilename) {
     printf("Getting Game information data (the thing that comes up when you press F1)\n");
     // Game information data (the thing that comes up when you press F1)
     pos += 4;
-    if (!InflateBlock(buffer, &pos, &data, &dataLength, &outputSize)) {
+    if (!inflater->Next(AssetKind::GameInfo, &pos, &data, &outputSize)) {
         // Error reading game information
-        free(data);
-        delete[] buffer;
+        delete inflater;
+        UnmapFile(&gameFile);
         return false;
     }
 
@@ -1288,6 +1522,7 @@ bool GameLoad(const char* pFilename) {
     _info.onTop = ReadDword(data, &dataPos);
     _info.freezeGame = ReadDword(data, &dataPos);
     _info.gameInfo = ReadString(data, &dataPos);
+    delete inflater;
 
     printf("Garbage\n");
     // Garbage?
@@ -1305,6 +1540,7 @@ bool GameLoad(const char* pFilename) {
     for (unsigned int i = 0; i < _roomOrderCount; i++) {
         _roomOrder[i] = ReadDword(buffer, &pos);
     }
+    unsigned int dataEnd = pos;
     printf("Set Room Order\n");
     CodeManager::SetRoomOrder(&_roomOrder, _roomOrderCount);
 
@@ -1312,6 +1548,7 @@ bool GameLoad(const char* pFilename) {
     // Compile object parented event lists and identities
     AssetManager::CompileObjectIdentities();
 
+    // These loops only mark which code objects need compiling. It's all compiled together by CodeManager::CompileAll() below.
     printf("Compile Scripts\n");
     // Compile scripts
     for (unsigned int i = 0; i < scriptCount; i++) {
@@ -1320,8 +1557,7 @@ bool GameLoad(const char* pFilename) {
             if (!CodeManager::Compile(s->codeObj)) {
                 // Error compiling script
                 printf("Error compiling scripts\n");
-                free(data);
-                delete[] buffer;
+                UnmapFile(&gameFile);
                 return false;
             }
         }
@@ -1335,8 +1571,7 @@ bool GameLoad(const char* pFilename) {
                 for (unsigned int k = 0; k < j.second.actionCount; k++) {
                     if (!CodeActionManager::Compile(j.second.actions[k])) {
                         // Error compiling script
-                        free(data);
-                        delete[] buffer;
+                        UnmapFile(&gameFile);
                         return false;
                     }
                 }
@@ -1354,8 +1589,7 @@ bool GameLoad(const char* pFilename) {
                         if (!CodeActionManager::Compile(ev.second.actions[k])) {
                             // Error compiling script
                             //printf("Error in \n"+CodeActionManager::Compile(ev.second.actions[k]));
-                            free(data);
-                            delete[] buffer;
+                            UnmapFile(&gameFile);
                             return false;
                         }
                     }
@@ -1370,8 +1604,7 @@ bool GameLoad(const char* pFilename) {
         if (t->exists) {
             if (!CodeManager::Compile(t->codeObj)) {
                 // Error compiling script
-                free(data);
-                delete[] buffer;
+                UnmapFile(&gameFile);
                 return false;
             }
         }
@@ -1383,25 +1616,37 @@ bool GameLoad(const char* pFilename) {
         if (r->exists) {
             if (!CodeManager::Compile(r->creationCode)) {
                 // Error compiling script
-                free(data);
-                delete[] buffer;
+                UnmapFile(&gameFile);
                 return false;
             }
             for (unsigned int j = 0; j < r->instanceCount; j++) {
                 if (!CodeManager::Compile(r->instances[j].creation)) {
                     // Error compiling script
-                    free(data);
-                    delete[] buffer;
+                    UnmapFile(&gameFile);
                     return false;
                 }
             }
         }
     }
 
+    printf("Compile GML\n");
+    if (!CodeManager::CompileAll()) {
+        printf("Error compiling GML\n");
+        UnmapFile(&gameFile);
+        return false;
+    }
+    InstanceList::BuildFieldLayouts();
+
+    // Store everything we decoded, so next time we don't have to
+    if (!cached && USE_GAME_CACHE) {
+        if (!cacheWriter.Finish(gameKey, gameHash, version, blocks, buffer, streamStart, settingsEnd, dataStart, dataEnd)) {
+            printf("Couldn't write game cache\n");
+        }
+    }
+
     printf("Clean up\n");
     // Cleaning up
-    free(data);
-    delete[] buffer;
+    UnmapFile(&gameFile);
 
     return true;
 }
@@ -0,0 +1,260 @@
+#include "GameCache.hpp"
+#include "StreamUtil.hpp"
+#include <string.h>
+#include <sys/stat.h>
+
+// Bump this whenever the cache layout, or anything GameLoad puts into it, changes
+constexpr unsigned int CACHE_FORMAT_VERSION = 2;
+constexpr unsigned int CACHE_HEADER_SIZE = 56;
+constexpr unsigned int CACHE_INDEX_ENTRY_SIZE = 16;
+constexpr unsigned int CACHE_MODIFIED_OFFSET = 12;
+
+// How much of the game file goes into a key's sample hash: the head and tail, and a few blocks spread evenly between them
+constexpr size_t SAMPLE_EDGE_SIZE = 0x10000;
+constexpr size_t SAMPLE_BLOCK_SIZE = 0x1000;
+constexpr size_t SAMPLE_BLOCK_COUNT = 16;
+
+constexpr unsigned long long FNV_PRIME = 0x100000001B3ULL;
+constexpr unsigned long long FNV_OFFSET = 0xCBF29CE484222325ULL;
+
+unsigned long long _hashInto(unsigned long long hash, const unsigned char* data, size_t length) {
+    // FNV-1a, but eating 8 bytes at a time so it keeps up with the disk
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        unsigned long long word;
+        memcpy(&word, data + i, 8);
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+    for (; i < length; i++) {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+    return hash;
+}
+
+unsigned long long GameCache::Hash(const unsigned char* data, size_t length) {
+    return _hashInto(FNV_OFFSET, data, length) ^ static_cast<unsigned long long>(length);
+}
+
+GameCache::Key GameCache::MakeKey(const char* filename, const unsigned char* data, size_t length) {
+    Key key;
+    key.size = length;
+
+    struct stat st;
+    key.modified = (stat(filename, &st) == 0) ? static_cast<unsigned long long>(st.st_mtime) : 0;
+
+    unsigned long long hash = FNV_OFFSET;
+    if (length <= (SAMPLE_EDGE_SIZE * 2)) {
+        hash = _hashInto(hash, data, length);
+    }
+    else {
+        hash = _hashInto(hash, data, SAMPLE_EDGE_SIZE);
+        size_t middle = length - (SAMPLE_EDGE_SIZE * 2);
+        for (size_t i = 0; i < SAMPLE_BLOCK_COUNT; i++) {
+            size_t offset = SAMPLE_EDGE_SIZE + ((middle / SAMPLE_BLOCK_COUNT) * i);
+            size_t blockLength = (offset + SAMPLE_BLOCK_SIZE <= length - SAMPLE_EDGE_SIZE) ? SAMPLE_BLOCK_SIZE : (length - SAMPLE_EDGE_SIZE - offset);
+            hash = _hashInto(hash, data + offset, blockLength);
+        }
+        hash = _hashInto(hash, data + length - SAMPLE_EDGE_SIZE, SAMPLE_EDGE_SIZE);
+    }
+    key.sample = hash ^ static_cast<unsigned long long>(length);
+    return key;
+}
+
+void _writeDword(unsigned char* out, unsigned int value) {
+    out[0] = (value & 0x000000FF);
+    out[1] = (value & 0x0000FF00) >> 8;
+    out[2] = (value & 0x00FF0000) >> 16;
+    out[3] = (value & 0xFF000000) >> 24;
+}
+
+void _appendDword(std::vector<unsigned char>& out, unsigned int value) {
+    unsigned char bytes[4];
+    _writeDword(bytes, value);
+    out.insert(out.end(), bytes, bytes + 4);
+}
+
+unsigned long long _readQword(const unsigned char* data, unsigned int* pos) {
+    unsigned long long value = ReadDword(data, pos);
+    return value | (static_cast<unsigned long long>(ReadDword(data, pos)) << 32);
+}
+
+void _writeQword(unsigned char* out, unsigned long long value) {
+    _writeDword(out, static_cast<unsigned int>(value & 0xFFFFFFFF));
+    _writeDword(out + 4, static_cast<unsigned int>(value >> 32));
+}
+
+bool GameCache::Open(const char* filename, const Key& key, const unsigned char* game, MappedFile* file, int* version, unsigned char** stream,
+                     unsigned int* streamLength, std::vector<AssetBlock>& blocks) {
+    if (!MapFile(filename, file)) return false;
+
+    unsigned int pos = 0;
+    if (file->size < CACHE_HEADER_SIZE || memcmp(file->data, "GM8C", 4) != 0) {
+        UnmapFile(file);
+        return false;
+    }
+    pos += 4;
+
+    unsigned int formatVersion = ReadDword(file->data, &pos);
+    unsigned int cachedGameSize = ReadDword(file->data, &pos);
+    unsigned long long cachedModified = _readQword(file->data, &pos);
+    unsigned long long cachedSample = _readQword(file->data, &pos);
+    unsigned long long cachedHash = _readQword(file->data, &pos);
+    if (formatVersion != CACHE_FORMAT_VERSION || cachedGameSize != key.size || cachedSample != key.sample) {
+        UnmapFile(file);
+        return false;
+    }
+
+    // The game's been touched since the cache was made, but that doesn't mean it changed (it may just have been copied.) Only now is it worth
+    // hashing the whole thing. If it's the same game after all, restamp the cache so the next launch doesn't have to do this again.
+    if (cachedModified != key.modified) {
+        if (cachedHash != Hash(game, key.size)) {
+            UnmapFile(file);
+            return false;
+        }
+        FILE* stamp = fopen(filename, "r+b");
+        if (stamp) {
+            unsigned char modified[8];
+            _writeQword(modified, key.modified);
+            if (fseek(stamp, CACHE_MODIFIED_OFFSET, SEEK_SET) == 0) fwrite(modified, 1, 8, stamp);
+            fclose(stamp);
+        }
+    }
+
+    (*version) = static_cast<int>(ReadDword(file->data, &pos));
+    unsigned int streamOffset = ReadDword(file->data, &pos);
+    (*streamLength) = ReadDword(file->data, &pos);
+    unsigned int indexOffset = ReadDword(file->data, &pos);
+    unsigned int blockCount = ReadDword(file->data, &pos);
+    if (static_cast<size_t>(streamOffset) + (*streamLength) > file->size || static_cast<size_t>(indexOffset) + (static_cast<size_t>(blockCount) * CACHE_INDEX_ENTRY_SIZE) > file->size) {
+        UnmapFile(file);
+        return false;
+    }
+    (*stream) = file->data + streamOffset;
+
+    blocks.clear();
+    blocks.reserve(blockCount);
+    pos = indexOffset;
+    for (unsigned int i = 0; i < blockCount; i++) {
+        AssetBlock block;
+        block.kind = static_cast<AssetKind>(ReadDword(file->data, &pos));
+        block.pos = ReadDword(file->data, &pos);
+        block.length = 0;
+        unsigned int offset = ReadDword(file->data, &pos);
+        block.size = ReadDword(file->data, &pos);
+        if (static_cast<size_t>(offset) + block.size > file->size || block.kind > AssetKind::GameInfo) {
+            UnmapFile(file);
+            blocks.clear();
+            return false;
+        }
+        block.data = file->data + offset;
+        block.done = true;
+        blocks.push_back(block);
+    }
+    return true;
+}
+
+bool GameCache::Writer::Begin(const char* filename) {
+    _filename = filename;
+    _tmpFilename = _filename + ".tmp";
+    _file = fopen(_tmpFilename.c_str(), "wb");
+    if (!_file) return false;
+
+    // Header gets filled in by Finish()
+    unsigned char header[CACHE_HEADER_SIZE] = {};
+    _offset = CACHE_HEADER_SIZE;
+    return fwrite(header, 1, CACHE_HEADER_SIZE, _file) == CACHE_HEADER_SIZE;
+}
+
+void GameCache::Writer::AddBlock(const AssetBlock& block) {
+    if (!_file) return;
+
+    IndexEntry entry;
+    entry.kind = block.kind;
+    entry.pos = block.pos;
+    entry.offset = _offset;
+    entry.size = block.size;
+    if (block.size && fwrite(block.data, 1, block.size, _file) != block.size) {
+        Abort();
+        return;
+    }
+    _offset += block.size;
+    _index.push_back(entry);
+}
+
+bool GameCache::Writer::Finish(const Key& key, unsigned long long hash, int version, const std::vector<AssetBlock>& blocks, const unsigned char* stream, unsigned int streamStart,
+                               unsigned int settingsEnd, unsigned int dataStart, unsigned int dataEnd) {
+    if (!_file) return false;
+    if (_index.size() != blocks.size()) {
+        Abort();
+        return false;
+    }
+
+    // Build the decoded stream: the settings block, an empty D3D wrapper, then the decrypted data paragraphs with each asset block cut down to a stub.
+    std::vector<unsigned char> decoded;
+    decoded.insert(decoded.end(), stream + streamStart, stream + settingsEnd);
+    _appendDword(decoded, 0);
+    _appendDword(decoded, 0);
+
+    unsigned int pos = dataStart;
+    for (size_t i = 0; i < blocks.size(); i++) {
+        if (_index[i].pos != blocks[i].pos || blocks[i].pos < pos) {
+            Abort();
+            return false;
+        }
+        decoded.insert(decoded.end(), stream + pos, stream + blocks[i].pos);
+        _index[i].pos = static_cast<unsigned int>(decoded.size());
+        _appendDword(decoded, 0);
+        pos = blocks[i].pos + 4 + blocks[i].length;
+    }
+    decoded.insert(decoded.end(), stream + pos, stream + dataEnd);
+
+    unsigned int streamOffset = _offset;
+    unsigned int indexOffset = streamOffset + static_cast<unsigned int>(decoded.size());
+    std::vector<unsigned char> index;
+    index.reserve(_index.size() * CACHE_INDEX_ENTRY_SIZE);
+    for (const IndexEntry& entry : _index) {
+        _appendDword(index, static_cast<unsigned int>(entry.kind));
+        _appendDword(index, entry.pos);
+        _appendDword(index, entry.offset);
+        _appendDword(index, entry.size);
+    }
+
+    unsigned char header[CACHE_HEADER_SIZE];
+    memcpy(header, "GM8C", 4);
+    _writeDword(header + 4, CACHE_FORMAT_VERSION);
+    _writeDword(header + 8, static_cast<unsigned int>(key.size));
+    _writeQword(header + CACHE_MODIFIED_OFFSET, key.modified);
+    _writeQword(header + 20, key.sample);
+    _writeQword(header + 28, hash);
+    _writeDword(header + 36, static_cast<unsigned int>(version));
+    _writeDword(header + 40, streamOffset);
+    _writeDword(header + 44, static_cast<unsigned int>(decoded.size()));
+    _writeDword(header + 48, indexOffset);
+    _writeDword(header + 52, static_cast<unsigned int>(_index.size()));
+
+    bool ok = (fwrite(decoded.data(), 1, decoded.size(), _file) == decoded.size()) && (fwrite(index.data(), 1, index.size(), _file) == index.size()) &&
+              (fseek(_file, 0, SEEK_SET) == 0) && (fwrite(header, 1, CACHE_HEADER_SIZE, _file) == CACHE_HEADER_SIZE);
+    ok = (fclose(_file) == 0) && ok;
+    _file = nullptr;
+    if (!ok) {
+        remove(_tmpFilename.c_str());
+        return false;
+    }
+
+    // rename() won't replace an existing file everywhere, so get rid of any stale cache first
+    remove(_filename.c_str());
+    if (rename(_tmpFilename.c_str(), _filename.c_str()) != 0) {
+        remove(_tmpFilename.c_str());
+        return false;
+    }
+    return true;
+}
+
+void GameCache::Writer::Abort() {
+    if (_file) {
+        fclose(_file);
+        _file = nullptr;
+        remove(_tmpFilename.c_str());
+    }
+    _index.clear();
+}
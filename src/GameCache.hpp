@@ -0,0 +1,81 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// Kinds of zlib-compressed asset block found in the game data, in the order they appear
+enum struct AssetKind { Trigger, Sound, Sprite, Background, Path, Script, Font, Timeline, Object, Room, IncludeFile, GameInfo };
+
+// A compressed asset block somewhere in the stream. "pos" is the position of the length dword which precedes the compressed data.
+struct AssetBlock {
+    AssetKind kind;
+    unsigned int pos;
+    unsigned int length;
+
+    // Filled in once the block has been inflated
+    unsigned char* data = nullptr;
+    unsigned int size = 0;
+    bool done = false;
+    bool failed = false;
+};
+
+// The game cache stores everything GameLoad decodes from game.exe, so that later launches of the same game don't have to decrypt or inflate anything.
+// It's made of a "decoded stream", which is the game's data paragraphs after all decryption, where every asset block has been replaced by a zero-length
+// stub; followed by the inflated contents of each of those blocks, with sprite and background pixels already converted to RGBA.
+// Compiled code isn't cached: bytecode refers to fields by numbers which are handed out in whatever order code happens to get compiled, and with
+// lazy compilation most of it doesn't exist yet when the cache is written.
+namespace GameCache {
+    // Cheaply identifies a game file, without reading all of it: its size, modification time, and a hash of its head, its tail and some blocks between.
+    struct Key {
+        size_t size;
+        unsigned long long modified;
+        unsigned long long sample;
+    };
+    Key MakeKey(const char* filename, const unsigned char* data, size_t length);
+
+    // Hashes a whole game file. This is only needed when a key's modification time doesn't match, to tell whether the game really changed.
+    unsigned long long Hash(const unsigned char* data, size_t length);
+
+    // Opens the cache at the given path and checks it was made from a game file with this key. If only the modification time differs, the game data
+    // ("game", which must be key.size bytes) is hashed in full to decide. On success, "file" holds the mapped cache, which owns the decoded stream
+    // and all the block data, so it must stay open until loading is done.
+    bool Open(const char* filename, const Key& key, const unsigned char* game, MappedFile* file, int* version, unsigned char** stream,
+              unsigned int* streamLength, std::vector<AssetBlock>& blocks);
+
+    // Writes a new cache while the game is being loaded from game.exe. Blocks are written as soon as they're parsed, so they don't all have to be kept
+    // in memory. Nothing is visible at the final path until Finish() succeeds.
+    class Writer {
+      private:
+        struct IndexEntry {
+            AssetKind kind;
+            unsigned int pos;
+            unsigned int offset;
+            unsigned int size;
+        };
+
+        FILE* _file;
+        std::string _filename;
+        std::string _tmpFilename;
+        std::vector<IndexEntry> _index;
+        unsigned int _offset;
+
+      public:
+        Writer() : _file(nullptr), _offset(0) {}
+        ~Writer() { Abort(); }
+
+        bool Begin(const char* filename);
+
+        // Adds a block, after it's been parsed. These must be added in the same order as in the game file.
+        void AddBlock(const AssetBlock& block);
+
+        // Writes the decoded stream and block index, then moves the cache into place. "blocks" are the blocks from the scan of game.exe,
+        // "stream" is the decrypted game data starting at streamStart, and the remaining arguments are the spans of it which make up the decoded stream.
+        bool Finish(const Key& key, unsigned long long hash, int version, const std::vector<AssetBlock>& blocks, const unsigned char* stream, unsigned int streamStart,
+                    unsigned int settingsEnd, unsigned int dataStart, unsigned int dataEnd);
+
+        // Discards a cache that was never finished
+        void Abort();
+    };
+};
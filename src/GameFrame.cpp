@@ -1,3 +1,4 @@
+#include "AlarmManager.hpp"
 #include "CodeActionManager.hpp"
 #include "CodeRunner.hpp"
 #include "Collision.hpp"
@@ -6,10 +7,37 @@
 #include "GamePrivateGlobals.hpp"
 #include "InputHandler.hpp"
 #include "Instance.hpp"
+#include "Movement.hpp"
 #include "Renderer.hpp"
 #include <cmath>
 #include <climits>
 
+// Gets all the code objects which are likely to run in the given room: its creation codes, and the events of every object instanced there.
+void _getRoomCodeObjects(unsigned int id, std::vector<CodeObject>& out) {
+    Room* room = AssetManager::GetRoom(id);
+    if (!room->exists) return;
+    out.push_back(room->creationCode);
+
+    std::vector<bool> seen(AssetManager::GetObjectCount(), false);
+    for (unsigned int i = 0; i < room->instanceCount; i++) {
+        out.push_back(room->instances[i].creation);
+
+        // Events are inherited, so parents will be running code here too
+        int oIndex = static_cast<int>(room->instances[i].objectIndex);
+        while (oIndex >= 0 && oIndex < static_cast<int>(seen.size()) && !seen[oIndex]) {
+            seen[oIndex] = true;
+            Object* o = AssetManager::GetObject(oIndex);
+            if (!o->exists) break;
+            for (unsigned int ev = 0; ev < 12; ev++) {
+                for (const auto& event : o->events[ev]) {
+                    CodeActionManager::GetCodeObjects(event.second.actions, event.second.actionCount, out);
+                }
+            }
+            oIndex = o->parentIndex;
+        }
+    }
+}
+
 bool GameLoadRoom(int id) {
     // Check room index is valid
     if (id < 0) return false;
@@ -21,6 +49,17 @@ bool GameLoadRoom(int id) {
     // Check room exists
     if (!room->exists) return false;
 
+    // If code is being compiled lazily, start compiling what this room and the next one will need
+    std::vector<CodeObject> warm;
+    _getRoomCodeObjects(id, warm);
+    for (unsigned int i = 0; i + 1 < _roomOrderCount; i++) {
+        if (_roomOrder[i] == static_cast<unsigned int>(id)) {
+            _getRoomCodeObjects(_roomOrder[i + 1], warm);
+            break;
+        }
+    }
+    CodeManager::Warm(warm);
+
     InstanceList::Iterator iter;
     InstanceHandle i;
     while ((i = iter.Next()) != InstanceList::NoInstance) {
@@ -33,11 +72,7 @@ bool GameLoadRoom(int id) {
     }
 
     // Backup persistent instances
-    std::vector<Instance> persistent;
-    InstanceList::LambdaIterator lit([](Instance& inst) -> bool {return inst.persistent;});
-    while ((i = lit.Next()) != InstanceList::NoInstance) {
-        persistent.push_back(InstanceList::GetInstance(i));
-    }
+    const std::vector<Instance>& persistent = InstanceList::BackupPersistent();
     InstanceList::ClearAll();
 
     // Clear inputs, because gm8 does this for some reason
@@ -113,7 +148,7 @@ bool GameLoadRoom(int id) {
     }
 
     // Restore persistent instances
-    InstanceList::AddInstances(persistent);
+    InstanceList::RestorePersistent();
 
     // run room's creation code
     if (!CodeManager::Run(room->creationCode, InstanceList::GetDummyInstance(), InstanceList::NoInstance, 11, 32, 0)) return false;
@@ -131,6 +166,8 @@ bool GameLoadRoom(int id) {
     return true;
 }
 
+// Reused by the passes in GameFrame() which go over the motion arrays
+std::vector<unsigned int> _motionIndices;
 
 bool GameFrame() {
     InstanceHandle instance;
@@ -140,10 +177,11 @@ bool GameFrame() {
     //InputUpdate();
 
     // Set all xprevious and yprevious
-    while ((instance = iter.Next()) != InstanceList::NoInstance) {
-        Instance& i = InstanceList::GetInstance(instance);
-        i.xprevious = i.x;
-        i.yprevious = i.y;
+    InstanceMotion& motion = _instanceMotion;
+    InstanceList::GetMotionIndices(_motionIndices);
+    for (unsigned int i : _motionIndices) {
+        motion.xprevious[i] = motion.x[i];
+        motion.yprevious[i] = motion.y[i];
     }
 
     // TODO: "begin step" trigger events
@@ -167,37 +205,38 @@ bool GameFrame() {
         if (inst.timeline_running) {
             Timeline* timeline = AssetManager::GetTimeline(inst.timeline_index);
             if (timeline->exists) {
+                int timelineIndex = inst.timeline_index;
                 double oldTPos = inst.timeline_position;
                 inst.timeline_position += inst.timeline_speed;
                 double newTPos = inst.timeline_position;
 
-                for (const auto& m : timeline->moments) {
-                    if (m.first >= oldTPos && m.first < newTPos) {
-                        if (!CodeActionManager::Run(m.second.actions, m.second.actionCount, instance, InstanceList::NoInstance, 0, 0, inst.object_index)) return false;
-                    }
+                // Carry on from the moment last step got to, unless the timeline's been changed or moved since
+                TimelineCursor& cursor = inst._timelineCursor;
+                size_t m = (cursor.timeline == timelineIndex && cursor.position == oldTPos) ? cursor.moment : timeline->FirstMoment(oldTPos);
+                for (; m < timeline->momentIndex.size() && timeline->momentIndex[m].position < newTPos; m++) {
+                    const IndexedEvent* moment = timeline->momentIndex[m].event;
+                    if (!CodeActionManager::Run(moment->actions, moment->actionCount, instance, InstanceList::NoInstance, 0, 0, inst.object_index)) return false;
                 }
+
+                // Going backwards, there could be moments between the new position and the one m is at
+                cursor.timeline = (newTPos >= oldTPos) ? timelineIndex : -1;
+                cursor.position = newTPos;
+                cursor.moment = m;
             }
         }
     }
 
     // Subtract from alarms and run event if they reach 0
-    for (const auto& ev : AssetManager::GetEventHolderList(2)) {      // alarm number
-        for (const unsigned int& holder : ev.second) {  // event holder
-            iter = InstanceList::Iterator(holder);
-            while ((instance = iter.Next()) != InstanceList::NoInstance) {
-                Instance& inst = InstanceList::GetInstance(instance);
-                if (inst._alarms.count(ev.first)) {
-                    if (inst._alarms[ev.first] >= 0) {
-                        inst._alarms[ev.first]--;
-                        if (inst._alarms[ev.first] == 0) {
-                            if (!CodeActionManager::RunInstanceEvent(2, ev.first, instance, instance, inst.object_index)) return false;
-                            if (_globals.changeRoom) return GameLoadRoom(_globals.roomTarget);
-                        }
-                    }
-                }
-            }
+    unsigned int alarm;
+    AlarmManager::BeginPhase();
+    while (AlarmManager::NextDue(&instance, &alarm)) {
+        if (!CodeActionManager::RunInstanceEvent(2, alarm, instance, instance, InstanceList::GetInstance(instance).object_index)) return false;
+        if (_globals.changeRoom) {
+            AlarmManager::EndPhase();
+            return GameLoadRoom(_globals.roomTarget);
         }
     }
+    AlarmManager::EndPhase();
 
     // Key events
     for (const auto& ev : AssetManager::GetEventHolderList(5)) {      // key number
@@ -254,41 +293,8 @@ bool GameFrame() {
     }
 
     // Movement
-    iter = InstanceList::Iterator();
-    while ((instance = iter.Next()) != InstanceList::NoInstance) {
-        Instance& inst = InstanceList::GetInstance(instance);
-
-        if (inst.friction != 0) {
-            // Subtract friction from speed towards 0
-            if (inst.speed < 0) {
-                inst.speed += inst.friction;
-                if (inst.speed > 0) inst.speed = 0;
-            }
-            else {
-                inst.speed -= inst.friction;
-                if (inst.speed < 0) inst.speed = 0;
-            }
-
-            // Recalculate hspeed/vspeed
-            inst.hspeed = cos(inst.direction * GML_PI / 180.0) * inst.speed;
-            inst.vspeed = -sin(inst.direction * GML_PI / 180.0) * inst.speed;
-        }
-
-        if (inst.gravity) {
-            // Apply gravity in gravity_direction to hspeed and vspeed
-            inst.hspeed += cos(inst.gravity_direction * GML_PI / 180.0) * inst.gravity;
-            inst.vspeed += -sin(inst.gravity_direction * GML_PI / 180.0) * inst.gravity;
-
-            // Recalculate speed and direction from hspeed/vspeed
-            inst.direction = ::atan2(-inst.vspeed, inst.hspeed) * 180.0 / GML_PI;
-            inst.speed = sqrt(pow(inst.hspeed, 2) + pow(inst.vspeed, 2));
-        }
-
-        // Apply hspeed and vspeed to x and y
-        inst.x += inst.hspeed;
-        inst.y += inst.vspeed;
-        if (inst.hspeed || inst.vspeed) inst.bboxIsStale = true;
-    }
+    InstanceList::GetMotionIndices(_motionIndices);
+    ApplyMovement(motion, _motionIndices);
 
     // Outside Room event
     for (unsigned int i : AssetManager::GetEventHolderList(7, 0)) {
@@ -298,7 +304,7 @@ bool GameFrame() {
 
             if (inst.object_index == i) {
                 RefreshInstanceBbox(&inst);
-                if ((inst.sprite_index < 0) ? (inst.x < 0 || inst.y < 0 || inst.x > ( int )_globals.room_width || inst.y > ( int )_globals.room_height)
+                if ((inst.sprite_index < 0) ? (inst.x() < 0 || inst.y() < 0 || inst.x() > ( int )_globals.room_width || inst.y() > ( int )_globals.room_height)
                                             : (inst.bbox_bottom < 0 || inst.bbox_right < 0 || inst.bbox_top > ( int )_globals.room_height || inst.bbox_left > ( int )_globals.room_width)) {
                     if (!CodeActionManager::RunInstanceEvent(7, 0, instance, InstanceList::NoInstance, inst.object_index)) return false;
                     if (_globals.changeRoom) return GameLoadRoom(_globals.roomTarget);
@@ -350,22 +356,22 @@ bool GameFrame() {
 
                             if (inst2.solid) {
                                 // If the target is solid, we move outside of it
-                                inst1.x = inst1.xprevious;
-                                inst1.y = inst1.yprevious;
-                                inst1.bboxIsStale = true;
+                                inst1.x() = inst1.xprevious();
+                                inst1.y() = inst1.yprevious();
+                                inst1.bboxIsStale() = true;
                             }
 
                             if (!CodeActionManager::RunInstanceEvent(4, target, instance, instance2, inst1.object_index)) return false;
                             if (_globals.changeRoom) return GameLoadRoom(_globals.roomTarget);
 
                             if (inst2.solid) {
-                                inst1.x += inst1.hspeed;
-                                inst1.y += inst1.vspeed;
-                                inst1.bboxIsStale = true;
+                                inst1.x() += inst1.hspeed();
+                                inst1.y() += inst1.vspeed();
+                                inst1.bboxIsStale() = true;
                                 if (CollisionCheck(&inst1, &inst2)) {
-                                    inst1.x -= inst1.hspeed;
-                                    inst1.y -= inst1.vspeed;
-                                    inst1.bboxIsStale = true;
+                                    inst1.x() -= inst1.hspeed();
+                                    inst1.y() -= inst1.vspeed();
+                                    inst1.bboxIsStale() = true;
                                 }
                             }
 
@@ -374,22 +380,22 @@ bool GameFrame() {
 
                             if (inst1.solid) {
                                 // If the target is solid, we move outside of it
-                                inst2.x = inst2.xprevious;
-                                inst2.y = inst2.yprevious;
-                                inst2.bboxIsStale = true;
+                                inst2.x() = inst2.xprevious();
+                                inst2.y() = inst2.yprevious();
+                                inst2.bboxIsStale() = true;
                             }
 
                             if (!CodeActionManager::RunInstanceEvent(4, ev.first, instance2, instance, inst2.object_index)) return false;
                             if (_globals.changeRoom) return GameLoadRoom(_globals.roomTarget);
 
                             if (inst1.solid) {
-                                inst2.x += inst2.hspeed;
-                                inst2.y += inst2.vspeed;
-                                inst2.bboxIsStale = true;
+                                inst2.x() += inst2.hspeed();
+                                inst2.y() += inst2.vspeed();
+                                inst2.bboxIsStale() = true;
                                 if (CollisionCheck(&inst2, &inst1)) {
-                                    inst2.x -= inst2.hspeed;
-                                    inst2.y -= inst2.vspeed;
-                                    inst2.bboxIsStale = true;
+                                    inst2.x() -= inst2.hspeed();
+                                    inst2.y() -= inst2.vspeed();
+                                    inst2.bboxIsStale() = true;
                                 }
                             }
                         }
@@ -481,7 +487,7 @@ bool GameFrame() {
                             printf("sprite get\n");
                             if (sprite->exists) {
                                 printf("sprite draw\n");
-                                RDrawImage(sprite->frames[(( int )inst.image_index) % sprite->frameCount], inst.x, inst.y, inst.image_xscale, inst.image_yscale, inst.image_angle, inst.image_blend, inst.image_alpha);
+                                RDrawImage(sprite->frames[(( int )inst.image_index()) % sprite->frameCount], inst.x(), inst.y(), inst.image_xscale, inst.image_yscale, inst.image_angle, inst.image_blend, inst.image_alpha);
                             }
 
 
@@ -537,16 +543,16 @@ bool GameFrame() {
     iter = InstanceList::Iterator();
     while ((instance = iter.Next()) != InstanceList::NoInstance) {
         Instance& inst = InstanceList::GetInstance(instance);
-        inst.image_index += inst.image_speed;
+        inst.image_index() += inst.image_speed();
 
         if (inst.sprite_index >= 0) {
             Sprite* s = AssetManager::GetSprite(inst.sprite_index);
-            if (inst.image_index >= s->frameCount) {
-                inst.image_index -= s->frameCount;
+            if (inst.image_index() >= s->frameCount) {
+                inst.image_index() -= s->frameCount;
                 if (!CodeActionManager::RunInstanceEvent(7, 7, instance, InstanceList::NoInstance, inst.object_index)) return false;  // Animation End event
                 if (_globals.changeRoom) return GameLoadRoom(_globals.roomTarget);
             }
-            if (inst.image_speed && s->separateCollision) inst.bboxIsStale = true;
+            if (inst.image_speed() && s->separateCollision) inst.bboxIsStale() = true;
         }
     }
 
@@ -1,12 +1,55 @@
 #pragma once
 #include "CRGMLType.hpp"
+#include "InstanceFields.hpp"
+#include <cstdint>
+#include <vector>
 
 typedef unsigned int InstanceID;
 
+// Motion and animation state of every instance. It's kept in one array per variable, apart from the rest of Instance, so the passes
+// that update it every frame only go through memory they actually use. InstanceList owns it and gives each instance an index into it.
+struct InstanceMotion {
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> xprevious;
+    std::vector<double> yprevious;
+    std::vector<double> hspeed;
+    std::vector<double> vspeed;
+    std::vector<double> speed;
+    std::vector<double> direction;
+    std::vector<double> friction;
+    std::vector<double> gravity;
+    std::vector<double> gravity_direction;
+    std::vector<double> image_index;
+    std::vector<double> image_speed;
+    std::vector<unsigned char> bboxIsStale;
+
+    void Resize(size_t size);
+    void Copy(const InstanceMotion& from, size_t fromIndex, size_t toIndex);
+};
+extern InstanceMotion _instanceMotion;
+
+// Where an instance's timeline got to last step, so that the next step can carry on from there rather than search the moments again
+struct TimelineCursor {
+    int timeline;     // Which timeline it's for, or -1 for none
+    double position;  // The timeline_position it was left at. If that's been changed since, the cursor's no good.
+    size_t moment;    // The first moment at or after that position
+};
+
+constexpr unsigned int ALARM_COUNT = 12;
+
+// One of an instance's alarms. Only AlarmManager should use these.
+struct InstanceAlarm {
+    int64_t value;        // What's left - or while it's counting down, the alarm phase on which it reaches 0
+    unsigned int ticket;  // 0 if it isn't counting down, otherwise the ticket of its entry in AlarmManager's schedule
+};
+
 // I've tried to name all the instance variables how they're referred to in GML where applicable.
 // read-only properties not included: sprite_width/height, sprite_xoffset/yoffset, image_number, bbox_bottom/left/right/top
+// Variables kept in InstanceMotion are got at through the functions of the same name.
 struct Instance {
     bool exists;
+    unsigned int motion;  // Index into _instanceMotion. It's next to exists so that finding the instances to move only has to look at the start of each.
     InstanceID id;
     int object_index;
     bool solid;
@@ -16,23 +59,10 @@ struct Instance {
     int sprite_index;
     double image_alpha;
     int image_blend;
-    double image_index;
-    double image_speed;
     double image_xscale;
     double image_yscale;
     double image_angle;
     int mask_index;
-    double direction;
-    double friction;
-    double gravity;
-    double gravity_direction;
-    double hspeed;
-    double vspeed;
-    double speed;
-    double x;
-    double y;
-    double xprevious;
-    double yprevious;
     double xstart;
     double ystart;
     int path_index;
@@ -52,8 +82,23 @@ struct Instance {
     int bbox_left;
     int bbox_right;
     int bbox_bottom;
-    bool bboxIsStale;
 
-    std::map<unsigned int, std::map<int, GMLType>> _fields;
-    std::map<unsigned int, int> _alarms;
+    InstanceFields _fields;
+    InstanceAlarm _alarms[ALARM_COUNT];
+    TimelineCursor _timelineCursor;
+
+    inline double& x() { return _instanceMotion.x[motion]; }
+    inline double& y() { return _instanceMotion.y[motion]; }
+    inline double& xprevious() { return _instanceMotion.xprevious[motion]; }
+    inline double& yprevious() { return _instanceMotion.yprevious[motion]; }
+    inline double& hspeed() { return _instanceMotion.hspeed[motion]; }
+    inline double& vspeed() { return _instanceMotion.vspeed[motion]; }
+    inline double& speed() { return _instanceMotion.speed[motion]; }
+    inline double& direction() { return _instanceMotion.direction[motion]; }
+    inline double& friction() { return _instanceMotion.friction[motion]; }
+    inline double& gravity() { return _instanceMotion.gravity[motion]; }
+    inline double& gravity_direction() { return _instanceMotion.gravity_direction[motion]; }
+    inline double& image_index() { return _instanceMotion.image_index[motion]; }
+    inline double& image_speed() { return _instanceMotion.image_speed[motion]; }
+    inline unsigned char& bboxIsStale() { return _instanceMotion.bboxIsStale[motion]; }
 };
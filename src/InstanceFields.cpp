@@ -0,0 +1,91 @@
+#include "InstanceFields.hpp"
+
+// Used by instances that haven't been given a layout
+static const FieldLayout _noLayout;
+
+const GMLArray InstanceFields::_unset;
+
+// The hash table is grown once it's this many quarters full
+constexpr unsigned int EXTRA_MAX_LOAD = 3;
+constexpr unsigned int EXTRA_MIN_SIZE = 8;
+
+void FieldLayout::Build(const std::vector<unsigned int>& fieldNumbers) {
+    slots.clear();
+    fields.clear();
+    if (fieldNumbers.empty()) return;
+
+    slots.assign(fieldNumbers.back() + 1, NoSlot);
+    for (unsigned int field : fieldNumbers) {
+        // Anything past what a slot number can hold will just have to use the hash table
+        if (fields.size() == NoSlot) break;
+        slots[field] = static_cast<unsigned short>(fields.size());
+        fields.push_back(field);
+    }
+}
+
+InstanceFields::InstanceFields() : _layout(&_noLayout), _extraCount(0) {}
+
+void InstanceFields::Reset(const FieldLayout* layout) {
+    _layout = layout ? layout : &_noLayout;
+    // Clearing keeps the capacity, so an instance reused from a pool doesn't have to allocate all this again
+    _slots.clear();
+    _slots.resize(_layout->fields.size());
+    _extra.clear();
+    _extraCount = 0;
+}
+
+void InstanceFields::CopyFrom(const InstanceFields& other) {
+    if (this == &other) return;
+    if (_layout == other._layout) {
+        _slots = other._slots;
+        _extra = other._extra;
+        _extraCount = other._extraCount;
+        return;
+    }
+
+    Reset(_layout);
+    for (size_t slot = 0; slot < other._slots.size(); slot++) Get(other._layout->fields[slot]) = other._slots[slot];
+    for (const Extra& extra : other._extra) {
+        if (extra.number != NoField) Get(extra.number) = extra.field;
+    }
+}
+
+GMLArray& InstanceFields::_getExtra(unsigned int field) {
+    if (_extra.empty()) _extra.resize(EXTRA_MIN_SIZE);
+
+    // Field numbers are handed out densely, so they make a fine hash as they are
+    size_t mask = _extra.size() - 1;
+    size_t i = field & mask;
+    while (_extra[i].number != field) {
+        if (_extra[i].number == NoField) {
+            if ((_extraCount + 1) * 4 > _extra.size() * EXTRA_MAX_LOAD) {
+                std::vector<Extra> old;
+                old.swap(_extra);
+                _extra.resize(old.size() * 2);
+                mask = _extra.size() - 1;
+                for (Extra& e : old) {
+                    if (e.number == NoField) continue;
+                    size_t j = e.number & mask;
+                    while (_extra[j].number != NoField) j = (j + 1) & mask;
+                    _extra[j].number = e.number;
+                    _extra[j].field = std::move(e.field);
+                }
+                return _getExtra(field);
+            }
+            _extra[i].number = field;
+            _extraCount++;
+            return _extra[i].field;
+        }
+        i = (i + 1) & mask;
+    }
+    return _extra[i].field;
+}
+
+const GMLArray* InstanceFields::_findExtra(unsigned int field) const {
+    if (_extra.empty()) return nullptr;
+    size_t mask = _extra.size() - 1;
+    for (size_t i = field & mask;; i = (i + 1) & mask) {
+        if (_extra[i].number == field) return &_extra[i].field;
+        if (_extra[i].number == NoField) return nullptr;
+    }
+}
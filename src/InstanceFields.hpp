@@ -0,0 +1,62 @@
+#pragma once
+#include "CRGMLType.hpp"
+#include <vector>
+
+// Where an object's instances keep each of their fields. Every field that code in the object's events (or its parents' events) uses
+// gets a slot, so reading or writing one is just an array index. It's shared by all instances of the object.
+struct FieldLayout {
+    static constexpr unsigned short NoSlot = 0xFFFF;
+    std::vector<unsigned short> slots;  // Indexed by field number. Fields past the end have no slot.
+    std::vector<unsigned int> fields;   // Indexed by slot
+
+    // Gives a slot to each of these field numbers, which must be sorted and unique
+    void Build(const std::vector<unsigned int>& fieldNumbers);
+};
+
+// The fields of one instance. Fields which have no slot in the instance's layout - ones only set by scripts, with() blocks on other objects,
+// or room creation code - go in a small hash table instead.
+class InstanceFields {
+  private:
+    static constexpr unsigned int NoField = 0xFFFFFFFF;
+    static const GMLArray _unset;
+    struct Extra {
+        unsigned int number = NoField;
+        GMLArray field;
+    };
+
+    const FieldLayout* _layout;
+    std::vector<GMLArray> _slots;
+    std::vector<Extra> _extra;  // Open addressing with linear probing. The size is always 0 or a power of 2, and nothing's ever removed.
+    unsigned int _extraCount;
+
+    GMLArray& _getExtra(unsigned int field);
+    const GMLArray* _findExtra(unsigned int field) const;
+
+  public:
+    InstanceFields();
+
+    // Clears all the fields and switches to a new layout. nullptr means no layout, so every field goes in the hash table.
+    void Reset(const FieldLayout* layout);
+
+    // Replaces all the fields with copies of another instance's, which may be using a different layout
+    void CopyFrom(const InstanceFields& other);
+
+    // Gets a field, creating it if it hasn't been used yet. References are only good until the next call, as the hash table may grow.
+    inline GMLArray& Get(unsigned int field) {
+        if (field < _layout->slots.size()) {
+            unsigned short slot = _layout->slots[field];
+            if (slot != FieldLayout::NoSlot) return _slots[slot];
+        }
+        return _getExtra(field);
+    }
+
+    // Reads an element of a field without creating anything. Fields that have never been set read as 0.
+    inline const GMLType& Read(unsigned int field, unsigned int index) const {
+        if (field < _layout->slots.size()) {
+            unsigned short slot = _layout->slots[field];
+            if (slot != FieldLayout::NoSlot) return _slots[slot].Read(index);
+        }
+        const GMLArray* extra = _findExtra(field);
+        return (extra ? extra : &_unset)->Read(index);
+    }
+};
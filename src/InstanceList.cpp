@@ -2,10 +2,13 @@
 #include "AssetManager.hpp"
 #include "CRGMLType.hpp"
 #include "CodeActionManager.hpp"
+#include "CodeRunner.hpp"
 #include "Instance.hpp"
 #include "Renderer.hpp"
 #include "Tile.hpp"
 #include <algorithm>  // for remove_if
+#include <deque>
+#include <unordered_map>
 #include <vector>
 #include <cstdint>
 
@@ -20,6 +23,9 @@ struct PooledType {
 
 struct PooledInstance : public PooledType {
     Instance instance;
+    unsigned int slot;        // Fixed for as long as the pool it's in exists
+    unsigned int generation;  // Goes up every time the slot is released, so that old handles to it can be told apart
+    size_t position;          // Where it is in _iterationOrder
     bool Draw();
     int GetDepth() {return instance.depth;}
     int GetObjectIndex() {return instance.object_index;}
@@ -34,14 +40,13 @@ struct PooledTile : public PooledType {
 
 // Template class for creating memory pools
 template <class T> struct Pool {
-    bool used;
     size_t size;
     T* data;
-    Pool(size_t pSize) : size(pSize), used(true) {
+    Pool(size_t pSize) : size(pSize) {
         data = new T[pSize];
     }
     Pool(const Pool& other) = delete;
-    Pool(Pool&& other) : data(other.data), size(other.size), used(other.used) {
+    Pool(Pool&& other) : data(other.data), size(other.size) {
         other.data = nullptr;
     }
     ~Pool() {
@@ -49,31 +54,216 @@ template <class T> struct Pool {
     }
     Pool& operator=(const Pool& other) = delete;
     Pool& operator=(Pool&& other) {
+        delete[] data;
         data = other.data;
         size = other.size;
-        used = other.used;
         other.data = nullptr;
         return *this;
     }
 };
-std::vector<Pool<PooledInstance>> _instancePools;
-std::vector<Pool<PooledTile>> _tilePools;
+
+// A set of pools sharing one free list, so getting a slot or giving one back never has to search for anything.
+// Pools only ever get added while things are allocated from them, since nothing can be moved once it's been handed out.
+// The free list is first in, first out: a released slot goes to the back of the queue, so it's only reused once every other free slot has been.
+// That keeps instance handle generations from wrapping round quickly when the same few instances are created and destroyed over and over.
+template <class T> struct PoolAllocator {
+    std::vector<Pool<T>> pools;
+    std::deque<T*> free;
+
+    void AddPool(size_t size) {
+        pools.push_back(Pool<T>(size));
+        T* data = pools.back().data;
+        for (size_t i = 0; i < size; i++) free.push_back(&data[i]);
+    }
+
+    // Returns nullptr if there's nothing free, in which case AddPool() needs calling first
+    T* Allocate() {
+        if (free.empty()) return nullptr;
+        T* place = free.front();
+        free.pop_front();
+        place->used = true;
+        return place;
+    }
+
+    void Release(T* place) {
+        place->used = false;
+        free.push_back(place);
+    }
+
+    // For once nothing is allocated. Frees all but the biggest pool, which is the last one added.
+    void Reset() {
+        if (pools.empty()) return;
+        Pool<T> last = std::move(pools.back());
+        pools.clear();
+        free.clear();
+        size_t size = last.size;
+        pools.push_back(std::move(last));
+        T* data = pools.back().data;
+        for (size_t i = 0; i < size; i++) {
+            data[i].used = false;
+            free.push_back(&data[i]);
+        }
+    }
+
+    void Clear() {
+        pools.clear();
+        free.clear();
+    }
+};
+PoolAllocator<PooledInstance> _instancePools;
+PoolAllocator<PooledTile> _tilePools;
 size_t _largestPoolSize;
 
+// Handles are a slot number in the low bits and the slot's generation in the high bits. Slots whose pool has been freed are null.
+// That leaves room for about a million slots before a handle could clash with NoInstance or DummyInstance. A slot's generation wraps after
+// 4096 reuses, but since the free list is FIFO, that's 4096 trips through every free slot in the pools, not just 4096 destroys.
+constexpr unsigned int HANDLE_SLOT_BITS = 20;
+constexpr unsigned int HANDLE_SLOT_MASK = (1u << HANDLE_SLOT_BITS) - 1;
+constexpr unsigned int HANDLE_GENERATION_MASK = (1u << (32 - HANDLE_SLOT_BITS)) - 1;
+std::vector<PooledInstance*> _slots;
+
+// Index 0 is the dummy instance's, and every slot's instance uses the slot number plus one
+InstanceMotion _instanceMotion;
+
+void InstanceMotion::Resize(size_t size) {
+    x.resize(size);
+    y.resize(size);
+    xprevious.resize(size);
+    yprevious.resize(size);
+    hspeed.resize(size);
+    vspeed.resize(size);
+    speed.resize(size);
+    direction.resize(size);
+    friction.resize(size);
+    gravity.resize(size);
+    gravity_direction.resize(size);
+    image_index.resize(size);
+    image_speed.resize(size);
+    bboxIsStale.resize(size);
+}
+
+void InstanceMotion::Copy(const InstanceMotion& from, size_t fromIndex, size_t toIndex) {
+    x[toIndex] = from.x[fromIndex];
+    y[toIndex] = from.y[fromIndex];
+    xprevious[toIndex] = from.xprevious[fromIndex];
+    yprevious[toIndex] = from.yprevious[fromIndex];
+    hspeed[toIndex] = from.hspeed[fromIndex];
+    vspeed[toIndex] = from.vspeed[fromIndex];
+    speed[toIndex] = from.speed[fromIndex];
+    direction[toIndex] = from.direction[fromIndex];
+    friction[toIndex] = from.friction[fromIndex];
+    gravity[toIndex] = from.gravity[fromIndex];
+    gravity_direction[toIndex] = from.gravity_direction[fromIndex];
+    image_index[toIndex] = from.image_index[fromIndex];
+    image_speed[toIndex] = from.image_speed[fromIndex];
+    bboxIsStale[toIndex] = from.bboxIsStale[fromIndex];
+}
+
+// Copies of persistent instances, kept while the room changes. Their motion indices are into _persistentMotion.
+std::vector<Instance> _persistent;
+InstanceMotion _persistentMotion;
+
+inline InstanceHandle _handleOf(const PooledInstance* inst) { return (inst->generation << HANDLE_SLOT_BITS) | inst->slot; }
+
+// Gets the instance a handle refers to, or nullptr if it's been released since the handle was made
+inline PooledInstance* _resolve(InstanceHandle handle) {
+    unsigned int slot = handle & HANDLE_SLOT_MASK;
+    if (slot >= _slots.size()) return nullptr;
+    PooledInstance* inst = _slots[slot];
+    return (inst && inst->used && inst->generation == (handle >> HANDLE_SLOT_BITS)) ? inst : nullptr;
+}
+
+// Indexed by object ID. These are never changed after BuildFieldLayouts(), as every instance holds a pointer to its object's layout.
+std::vector<FieldLayout> _fieldLayouts;
+
 std::vector<PooledInstance*> _iterationOrder;
 std::vector<PooledTile*> _tiles;
 std::vector<PooledType*> _drawOrder;
 
-Pool<PooledInstance>& _addInstancePool(size_t size) {
-    size_t poolCount = _instancePools.size();
-    _instancePools.push_back(Pool<PooledInstance>(size));
-    return _instancePools[poolCount];
+// Finds instances by ID. IDs are unique, but if one ever wasn't, this would find the first, like a search would.
+std::unordered_map<InstanceID, PooledInstance*> _idIndex;
+
+// For each object ID, all the instances which are that object or one of its children, in iteration order
+typedef std::vector<PooledInstance*> Bucket;
+std::vector<Bucket> _objectBuckets;
+const Bucket _emptyBucket;
+
+inline const Bucket& _getBucket(unsigned int objectId) { return (objectId < _objectBuckets.size()) ? _objectBuckets[objectId] : _emptyBucket; }
+
+// Gets the position in a bucket of the first instance at or after this position in _iterationOrder
+inline size_t _bucketPosition(const Bucket& bucket, size_t position) {
+    return std::lower_bound(bucket.begin(), bucket.end(), position, [](PooledInstance* inst, size_t p) { return inst->position < p; }) - bucket.begin();
+}
+
+void _addToOrder(PooledInstance* place, InstanceID id, int objectIndex) {
+    place->position = _iterationOrder.size();
+    _iterationOrder.push_back(place);
+    _drawOrder.push_back(place);
+    _idIndex.emplace(id, place);
+
+    if (objectIndex < 0 || objectIndex >= static_cast<int>(AssetManager::GetObjectCount())) return;
+    if (_objectBuckets.size() < AssetManager::GetObjectCount()) _objectBuckets.resize(AssetManager::GetObjectCount());
+    for (unsigned int identity : AssetManager::GetObject(objectIndex)->identities) _objectBuckets[identity].push_back(place);
+}
+
+void _clearIndices() {
+    _idIndex.clear();
+    for (Bucket& bucket : _objectBuckets) bucket.clear();
 }
 
-Pool<PooledTile>& _addTilePool(size_t size) {
-    size_t poolCount = _tilePools.size();
-    _tilePools.push_back(Pool<PooledTile>(size));
-    return _tilePools[poolCount];
+// Takes everything that's no longer used out of the iteration and draw orders and the indices. Instances keep their relative order.
+void _compactOrder() {
+    auto it2 = std::remove_if(_drawOrder.begin(), _drawOrder.end(), [](PooledType* inst) { return !inst->used; });
+    _drawOrder.erase(it2, _drawOrder.end());
+
+    bool removed = false;
+    for (PooledInstance* inst : _iterationOrder) {
+        if (inst->used) continue;
+        auto found = _idIndex.find(inst->instance.id);
+        if (found != _idIndex.end() && found->second == inst) _idIndex.erase(found);
+        removed = true;
+    }
+    if (!removed) return;
+
+    auto it = std::remove_if(_iterationOrder.begin(), _iterationOrder.end(), [](PooledInstance* inst) { return !inst->used; });
+    _iterationOrder.erase(it, _iterationOrder.end());
+    for (size_t i = 0; i < _iterationOrder.size(); i++) _iterationOrder[i]->position = i;
+    for (Bucket& bucket : _objectBuckets) {
+        bucket.erase(std::remove_if(bucket.begin(), bucket.end(), [](PooledInstance* inst) { return !inst->used; }), bucket.end());
+    }
+}
+
+void _addInstancePool(size_t size) {
+    _instancePools.AddPool(size);
+    Pool<PooledInstance>& pool = _instancePools.pools.back();
+    for (size_t i = 0; i < pool.size; i++) {
+        pool.data[i].slot = static_cast<unsigned int>(_slots.size());
+        pool.data[i].generation = 0;
+        pool.data[i].instance.motion = pool.data[i].slot + 1;
+        _slots.push_back(&pool.data[i]);
+    }
+    _instanceMotion.Resize(_slots.size() + 1);
+}
+
+PooledInstance* _allocateInstance() {
+    PooledInstance* place = _instancePools.Allocate();
+    if (place) return place;
+    _largestPoolSize *= 2;
+    _addInstancePool(_largestPoolSize);
+    return _instancePools.Allocate();
+}
+
+void _releaseInstance(PooledInstance* inst) {
+    inst->generation = (inst->generation + 1) & HANDLE_GENERATION_MASK;
+    _instancePools.Release(inst);
+}
+
+PooledTile* _allocateTile() {
+    PooledTile* place = _tilePools.Allocate();
+    if (place) return place;
+    _largestPoolSize *= 2;
+    _tilePools.AddPool(_largestPoolSize);
+    return _tilePools.Allocate();
 }
 
 // Last dynamic instance ID and tile ID to be assigned
@@ -91,50 +281,19 @@ void InstanceList::Init() {
 }
 
 void InstanceList::Finalize() {
-    _instancePools.clear();
+    _instancePools.Clear();
+    _slots.clear();
+    _tilePools.Clear();
     _iterationOrder.clear();
     _drawOrder.clear();
+    _clearIndices();
 }
 
 InstanceHandle InstanceList::AddInstance(InstanceID id, double x, double y, unsigned int objectId) {
-    PooledInstance* place = nullptr;
-    // Iterate all our pools looking for an unused spot
-    for (Pool<PooledInstance>& pool : _instancePools) {
-        if (pool.used) {
-            for (unsigned int i = 0; i < pool.size; i++) {
-                PooledInstance& pooledInst = pool.data[i];
-                if (!pooledInst.used) {
-                    pooledInst.used = true;
-                    place = &pooledInst;
-                    break;
-                }
-            }
-            if (place != nullptr) {
-                // break out of outer loop if we've already placed the instance
-                break;
-            }
-        }
-    }
-    // If we didn't manage to place the instance yet, we need to add a new pool
-    if (place == nullptr) {
-        // Mark all our pre-existing pools as disused (won't be allocated into, and will be de-allocated when empty)
-        for (Pool<PooledInstance>& pool : _instancePools) {
-            pool.used = false;
-        }
-        // Make the new pool
-        _largestPoolSize *= 2;
-        Pool<PooledInstance>& pool = _addInstancePool(_largestPoolSize);
-
-        // Use the first element in the instance pool as our new instance
-        pool.data[0].used = true;
-        place = &pool.data[0];
-    }
-
-    InstanceHandle ret = static_cast<InstanceHandle>(_iterationOrder.size());
-    _iterationOrder.push_back(place);
-    _drawOrder.push_back(place);
+    PooledInstance* place = _allocateInstance();
+    _addToOrder(place, id, objectId);
     if (_InitInstance(&place->instance, id, x, y, objectId)) {
-        return ret;
+        return _handleOf(place);
     }
     else {
         return NoInstance;
@@ -147,39 +306,7 @@ InstanceHandle InstanceList::AddInstance(double x, double y, unsigned int object
 }
 
 unsigned int InstanceList::AddTile(unsigned int id, int background, int left, int top, unsigned int width, unsigned int height, double x, double y, int depth) {
-    PooledTile* place = nullptr;
-    // Iterate all our pools looking for an unused spot
-    for (Pool<PooledTile>& pool : _tilePools) {
-        if (pool.used) {
-            for (unsigned int i = 0; i < pool.size; i++) {
-                PooledTile& pooledTile = pool.data[i];
-                if (!pooledTile.used) {
-                    pooledTile.used = true;
-                    place = &pooledTile;
-                    break;
-                }
-            }
-            if (place != nullptr) {
-                // break out of outer loop if we've already placed the instance
-                break;
-            }
-        }
-    }
-    // If we didn't manage to place the instance yet, we need to add a new pool
-    if (place == nullptr) {
-        // Mark all our pre-existing pools as disused (won't be allocated into, and will be de-allocated when empty)
-        for (Pool<PooledTile>& pool : _tilePools) {
-            pool.used = false;
-        }
-        // Make the new pool
-        _largestPoolSize *= 2;
-        Pool<PooledTile>& pool = _addTilePool(_largestPoolSize);
-
-        // Use the first element in the instance pool as our new instance
-        pool.data[0].used = true;
-        place = &pool.data[0];
-    }
-
+    PooledTile* place = _allocateTile();
     _tiles.push_back(place);
     _drawOrder.push_back(place);
     place->tile = Tile(x, y, background, left, top, width, height, depth, id);
@@ -191,85 +318,62 @@ unsigned int InstanceList::AddTile(int background, int left, int top, unsigned i
     return AddTile(_lastTileID, background, left, top, width, height, x, y, depth);
 }
 
-void InstanceList::AddInstances(const std::vector<Instance>& instances) {
-    if (!instances.size()) return;
-    unsigned int pos = 0;
-    // Go through all used pools looking for places to put these instances
-    for (Pool<PooledInstance>& pool : _instancePools) {
-        if (pool.used) {
-            for (unsigned int i = 0; i < pool.size; i++) {
-                PooledInstance& pooledInst = pool.data[i];
-                if (!pooledInst.used) {
-                    pooledInst.instance = instances[pos];
-                    pooledInst.used = true;
-                    _iterationOrder.push_back(&pooledInst);
-                    _drawOrder.push_back(&pooledInst);
-                    pos++;
-                    if (pos == instances.size()) return;
-                }
-            }
-        }
+const std::vector<Instance>& InstanceList::BackupPersistent() {
+    _persistent.clear();
+    for (PooledInstance* inst : _iterationOrder) {
+        if (!inst->instance.exists || !inst->instance.persistent) continue;
+        unsigned int index = static_cast<unsigned int>(_persistent.size());
+        _persistent.push_back(inst->instance);
+        _persistent.back().motion = index;
+        _persistentMotion.Resize(index + 1);
+        _persistentMotion.Copy(_instanceMotion, inst->instance.motion, index);
     }
-    // Some instances weren't placed in our pool, so we need a new pool for them
-    size_t remainingCount = instances.size() - pos;
-    while (_largestPoolSize < remainingCount) _largestPoolSize *= 2;
-    Pool<PooledInstance>& newPool = _addInstancePool(_largestPoolSize);
-
-    unsigned int poolPos = 0;
-    while (pos < instances.size()) {
-        newPool.data[poolPos].used = true;
-        newPool.data[poolPos].instance = instances[pos];
-        poolPos++;
-        pos++;
+    return _persistent;
+}
+
+void InstanceList::RestorePersistent() {
+    for (const Instance& instance : _persistent) {
+        PooledInstance* place = _allocateInstance();
+        unsigned int motion = place->instance.motion;
+        place->instance = instance;
+        place->instance.motion = motion;
+        _instanceMotion.Copy(_persistentMotion, instance.motion, motion);
+        _addToOrder(place, instance.id, instance.object_index);
     }
+    _persistent.clear();
 }
 
 void InstanceList::ClearAll() {
-    for (PooledInstance* inst : _iterationOrder) {
-        inst->used = false;
-    }
-    for (PooledTile* tile : _tiles) {
-        tile->used = false;
+    // Slots in the pools that are about to be freed will never be used again, and nothing new can be given their numbers
+    for (PooledInstance* inst : _iterationOrder) inst->generation = (inst->generation + 1) & HANDLE_GENERATION_MASK;
+    for (size_t i = 0; i + 1 < _instancePools.pools.size(); i++) {
+        const Pool<PooledInstance>& pool = _instancePools.pools[i];
+        for (size_t j = 0; j < pool.size; j++) _slots[pool.data[j].slot] = nullptr;
     }
-    auto it = std::remove_if(_instancePools.begin(), _instancePools.end(), [](Pool<PooledInstance>& pool) { return !pool.used; });
-    _instancePools.erase(it, _instancePools.end());
     _iterationOrder.clear();
     _drawOrder.clear();
+    _clearIndices();
     _tiles.clear();
+    _instancePools.Reset();
+    _tilePools.Reset();
 }
 
 void InstanceList::ClearNonPersistent() {
-    for (const Pool<PooledInstance>& pool : _instancePools) {
-        for (unsigned int i = 0; i < pool.size; i++) {
-            PooledInstance& pooledInst = pool.data[i];
-            if (pooledInst.used) {
-                if ((!pooledInst.instance.persistent) || (!pooledInst.instance.exists)) pooledInst.used = false;
-            }
-        }
+    for (PooledInstance* inst : _iterationOrder) {
+        if ((!inst->instance.persistent) || (!inst->instance.exists)) _releaseInstance(inst);
     }
     for (PooledTile* tile : _tiles) {
-        tile->used = false;
+        _tilePools.Release(tile);
     }
-    auto it = std::remove_if(_iterationOrder.begin(), _iterationOrder.end(), [](PooledInstance* inst) { return !inst->used; });
-    _iterationOrder.erase(it, _iterationOrder.end());
-    auto it2 = std::remove_if(_drawOrder.begin(), _drawOrder.end(), [](PooledType* inst) { return !inst->used; });
-    _drawOrder.erase(it2, _drawOrder.end());
+    _compactOrder();
     _tiles.clear();
 }
 
 void InstanceList::ClearDeleted() {
-    for (const Pool<PooledInstance>& pool : _instancePools) {
-        for (unsigned int i = 0; i < pool.size; i++) {
-            PooledInstance& pooledInst = pool.data[i];
-            if (pooledInst.used) {
-                if (!pooledInst.instance.exists) pooledInst.used = false;
-            }
-        }
+    for (PooledInstance* inst : _iterationOrder) {
+        if (!inst->instance.exists) _releaseInstance(inst);
     }
-    auto it = std::remove_if(_iterationOrder.begin(), _iterationOrder.end(), [](PooledInstance* inst) { return !inst->used; });
-    _iterationOrder.erase(it, _iterationOrder.end());
-    auto it2 = std::remove_if(_drawOrder.begin(), _drawOrder.end(), [](PooledType* inst) { return !inst->used; });
-    _drawOrder.erase(it2, _drawOrder.end());
+    _compactOrder();
 }
 
 bool InstanceList::DrawEverything() {
@@ -285,36 +389,45 @@ bool InstanceList::DrawEverything() {
 Instance* InstanceList::GetInstanceByNumber(unsigned int num, size_t startPos, size_t* endPos) {
     if (num > 100000) {
         // Instance ID
-        for (auto i = _iterationOrder.begin() + startPos; i != _iterationOrder.end(); i++) {
-            if ((*i)->instance.id == num) {
-                if (endPos) (*endPos) = startPos;
-                return ((*i)->instance.exists) ? &(*i)->instance : nullptr;
-            }
-            startPos++;
+        auto it = _idIndex.find(num);
+        if (it != _idIndex.end() && it->second->position >= startPos) {
+            if (endPos) (*endPos) = it->second->position;
+            Instance& instance = it->second->instance;
+            return instance.exists ? &instance : nullptr;
         }
+        startPos = _iterationOrder.size();
     }
     else {
         // Object ID
-        for (auto i = _iterationOrder.begin() + startPos; i != _iterationOrder.end(); i++) {
-            Object* o = AssetManager::GetObject((*i)->instance.object_index);
-            if (o->identities.count(num) && (*i)->instance.exists) {
-                if (endPos) (*endPos) = startPos;
-                return &(*i)->instance;
+        const Bucket& bucket = _getBucket(num);
+        for (size_t i = _bucketPosition(bucket, startPos); i < bucket.size(); i++) {
+            if (bucket[i]->instance.exists) {
+                if (endPos) (*endPos) = bucket[i]->position;
+                return &bucket[i]->instance;
             }
-            startPos++;
         }
+        startPos = _iterationOrder.size();
     }
     if (endPos) (*endPos) = startPos;
     return nullptr;
 }
 
-Instance _dummy;
+Instance _dummy;  // Its motion index is 0
 Instance& InstanceList::GetInstance(InstanceHandle handle) {
     if (handle == DummyInstance) return _dummy;
-    return _iterationOrder[handle]->instance;
+    return _slots[handle & HANDLE_SLOT_MASK]->instance;
+}
+
+bool InstanceList::IsValid(InstanceHandle handle) {
+    return handle == DummyInstance || _resolve(handle) != nullptr;
+}
+
+size_t InstanceList::GetPosition(InstanceHandle handle) {
+    return _slots[handle & HANDLE_SLOT_MASK]->position;
 }
 
 InstanceHandle InstanceList::GetDummyInstance() {
+    _dummy.motion = 0;
     _dummy.id = 0;
     _dummy.object_index = 0;
     _dummy.solid = false;
@@ -325,23 +438,23 @@ InstanceHandle InstanceList::GetDummyInstance() {
     _dummy.sprite_index = -1;
     _dummy.image_alpha = 1;
     _dummy.image_blend = 0xFFFFFF;
-    _dummy.image_index = 0;
-    _dummy.image_speed = 1;
+    _dummy.image_index() = 0;
+    _dummy.image_speed() = 1;
     _dummy.image_xscale = 1;
     _dummy.image_yscale = 1;
     _dummy.image_angle = 0;
     _dummy.mask_index = -1;
-    _dummy.direction = 0;
-    _dummy.gravity = 0;
-    _dummy.gravity_direction = 270;
-    _dummy.hspeed = 0;
-    _dummy.vspeed = 0;
-    _dummy.speed = 0;
-    _dummy.friction = 0;
-    _dummy.x = 0.0;
-    _dummy.y = 0.0;
-    _dummy.xprevious = 0.0;
-    _dummy.yprevious = 0.0;
+    _dummy.direction() = 0;
+    _dummy.gravity() = 0;
+    _dummy.gravity_direction() = 270;
+    _dummy.hspeed() = 0;
+    _dummy.vspeed() = 0;
+    _dummy.speed() = 0;
+    _dummy.friction() = 0;
+    _dummy.x() = 0.0;
+    _dummy.y() = 0.0;
+    _dummy.xprevious() = 0.0;
+    _dummy.yprevious() = 0.0;
     _dummy.xstart = 0.0;
     _dummy.ystart = 0.0;
     _dummy.path_index = -1;
@@ -360,9 +473,10 @@ InstanceHandle InstanceList::GetDummyInstance() {
     _dummy.bbox_right = -100000;
     _dummy.bbox_left = -100000;
     _dummy.bbox_top = -100000;
-    _dummy.bboxIsStale = false;
-    _dummy._fields.clear();
-    _dummy._alarms.clear();
+    _dummy.bboxIsStale() = false;
+    _dummy._fields.Reset(nullptr);
+    for (InstanceAlarm& alarm : _dummy._alarms) alarm = {-1, 0};
+    _dummy._timelineCursor.timeline = -1;
 
     return DummyInstance;
 }
@@ -371,6 +485,13 @@ size_t InstanceList::Count() {
     return _iterationOrder.size();
 }
 
+void InstanceList::GetMotionIndices(std::vector<unsigned int>& indices) {
+    indices.clear();
+    for (PooledInstance* inst : _iterationOrder) {
+        if (inst->instance.exists) indices.push_back(inst->instance.motion);
+    }
+}
+
 // Private
 
 bool _InitInstance(Instance* instance, unsigned int id, double x, double y, unsigned int objectId) {
@@ -387,23 +508,23 @@ bool _InitInstance(Instance* instance, unsigned int id, double x, double y, unsi
     instance->sprite_index = obj->spriteIndex;
     instance->image_alpha = 1;
     instance->image_blend = 0xFFFFFF;
-    instance->image_index = 0;
-    instance->image_speed = 1;
+    instance->image_index() = 0;
+    instance->image_speed() = 1;
     instance->image_xscale = 1;
     instance->image_yscale = 1;
     instance->image_angle = 0;
     instance->mask_index = obj->maskIndex;
-    instance->direction = 0;
-    instance->gravity = 0;
-    instance->gravity_direction = 270;
-    instance->hspeed = 0;
-    instance->vspeed = 0;
-    instance->speed = 0;
-    instance->friction = 0;
-    instance->x = x;
-    instance->y = y;
-    instance->xprevious = x;
-    instance->yprevious = y;
+    instance->direction() = 0;
+    instance->gravity() = 0;
+    instance->gravity_direction() = 270;
+    instance->hspeed() = 0;
+    instance->vspeed() = 0;
+    instance->speed() = 0;
+    instance->friction() = 0;
+    instance->x() = x;
+    instance->y() = y;
+    instance->xprevious() = x;
+    instance->yprevious() = y;
     instance->xstart = x;
     instance->ystart = y;
     instance->path_index = -1;
@@ -418,10 +539,11 @@ bool _InitInstance(Instance* instance, unsigned int id, double x, double y, unsi
     instance->timeline_speed = 1;
     instance->timeline_position = 0;
     instance->timeline_loop = false;
-    instance->bboxIsStale = true;
+    instance->bboxIsStale() = true;
 
-    instance->_fields.clear();
-    instance->_alarms.clear();
+    instance->_fields.Reset(objectId < _fieldLayouts.size() ? &_fieldLayouts[objectId] : nullptr);
+    for (InstanceAlarm& alarm : instance->_alarms) alarm = {-1, 0};
+    instance->_timelineCursor.timeline = -1;
     return true;
 }
 
@@ -429,25 +551,33 @@ bool _InitInstance(Instance* instance, unsigned int id, double x, double y, unsi
 uint32_t InstanceList::NoInstance = static_cast<uint32_t>(-1);
 uint32_t InstanceList::DummyInstance = static_cast<uint32_t>(-2);
 
-InstanceList::Iterator::Iterator(unsigned int id, InstanceHandle startPos) : _pos(startPos), _id(id), _byId(true), _limit(InstanceList::Count()) {}
-
 InstanceHandle InstanceList::Iterator::Next() {
-    if (_byId) {
+    if (_byId && _id <= 100000) {
+        // Buckets only grow while they're being iterated over, so this stays valid
+        const Bucket& bucket = _getBucket(_id);
+        while (_pos < bucket.size()) {
+            PooledInstance* inst = bucket[_pos++];
+            if (inst->position >= _limit) break;
+            if (inst->instance.exists) return _handleOf(inst);
+        }
+        return NoInstance;
+    }
+    else if (_byId) {
         size_t endpos;
         Instance* ret = InstanceList::GetInstanceByNumber(_id, _pos, &endpos);
         if (endpos >= _limit) return NoInstance;
         _pos = endpos + 1;
-        return static_cast<InstanceHandle>(endpos);
+        return _handleOf(_iterationOrder[endpos]);
     }
     else {
-        InstanceHandle ret;
+        PooledInstance* ret;
         while (true) {
             if (_pos >= _limit) return NoInstance;
-            ret = static_cast<InstanceHandle>(_pos);
+            ret = _iterationOrder[_pos];
             _pos++;
-            if (_iterationOrder[ret]->instance.exists) break;
+            if (ret->instance.exists) break;
         }
-        return ret;
+        return _handleOf(ret);
     }
 }
 
@@ -456,23 +586,56 @@ void InstanceList::SetLastIDs(unsigned int instance, unsigned int tile) {
     _lastTileID = tile;
 }
 
+void InstanceList::BuildFieldLayouts() {
+    unsigned int objectCount = AssetManager::GetObjectCount();
+    _fieldLayouts.assign(objectCount, FieldLayout());
+
+    std::vector<CodeObject> code;
+    std::vector<unsigned int> fields;
+    for (unsigned int i = 0; i < objectCount; i++) {
+        code.clear();
+        fields.clear();
+
+        // Events are inherited, so parents' code runs on this object's instances too. The count stops a broken parent loop going forever.
+        int oIndex = static_cast<int>(i);
+        for (unsigned int depth = 0; depth < objectCount && oIndex >= 0 && oIndex < static_cast<int>(objectCount); depth++) {
+            Object* o = AssetManager::GetObject(oIndex);
+            if (!o->exists) break;
+            for (unsigned int ev = 0; ev < 12; ev++) {
+                for (const auto& event : o->events[ev]) {
+                    CodeActionManager::GetCodeObjects(event.second.actions, event.second.actionCount, code);
+                }
+            }
+            oIndex = o->parentIndex;
+        }
+
+        for (CodeObject c : code) CodeManager::GetFields(c, fields);
+        std::sort(fields.begin(), fields.end());
+        fields.erase(std::unique(fields.begin(), fields.end()), fields.end());
+        _fieldLayouts[i].Build(fields);
+    }
+}
+
+const GMLType& InstanceList::ReadField(InstanceHandle instance, uint32_t field, uint32_t index) {
+    return GetInstance(instance)._fields.Read(field, index);
+}
 GMLType* InstanceList::GetField(InstanceHandle instance, uint32_t field) {
-    return &GetInstance(instance)._fields[field][0];
+    return &GetInstance(instance)._fields.Get(field).Write(0);
 }
 void InstanceList::SetField(InstanceHandle instance, uint32_t field, const GMLType& value) {
-    GetInstance(instance)._fields[field][0] = value;
+    GetInstance(instance)._fields.Get(field).Write(0) = value;
 }
 GMLType* InstanceList::GetField(InstanceHandle instance, uint32_t field, uint32_t array) {
-    return &GetInstance(instance)._fields[field][array];
+    return &GetInstance(instance)._fields.Get(field).Write(array);
 }
 void InstanceList::SetField(InstanceHandle instance, uint32_t field, uint32_t array, const GMLType& value) {
-    GetInstance(instance)._fields[field][array] = value;
+    GetInstance(instance)._fields.Get(field).Write(array) = value;
 }
 GMLType* InstanceList::GetField(InstanceHandle instance, uint32_t field, uint32_t array1, uint32_t array2) {
-    return &GetInstance(instance)._fields[field][(array1 * 32000) + array2];
+    return &GetInstance(instance)._fields.Get(field).Write((array1 * GML_ARRAY_SIZE) + array2);
 }
 void InstanceList::SetField(InstanceHandle instance, uint32_t field, uint32_t array1, uint32_t array2, const GMLType& value) {
-    GetInstance(instance)._fields[field][(array1 * 32000) + array2] = value;
+    GetInstance(instance)._fields.Get(field).Write((array1 * GML_ARRAY_SIZE) + array2) = value;
 }
 
 InstanceHandle InstanceList::LambdaIterator::Next() {
@@ -480,7 +643,7 @@ InstanceHandle InstanceList::LambdaIterator::Next() {
         if (_iterationOrder[_pos]->instance.exists) {
             if (func(_iterationOrder[_pos]->instance)) {
                 _pos++;
-                return static_cast<InstanceHandle>(_pos - 1);
+                return _handleOf(_iterationOrder[_pos - 1]);
             }
         }
         _pos++;
@@ -503,7 +666,7 @@ bool PooledInstance::Draw() {
             if (instance.sprite_index >= 0) {
                 Sprite* sprite = AssetManager::GetSprite(instance.sprite_index);
                 if (sprite->exists) {
-                    RDrawImage(sprite->frames[static_cast<int>(instance.image_index) % sprite->frameCount], instance.x, instance.y, instance.image_xscale, instance.image_yscale, instance.image_angle,
+                    RDrawImage(sprite->frames[static_cast<int>(instance.image_index()) % sprite->frameCount], instance.x(), instance.y(), instance.image_xscale, instance.image_yscale, instance.image_angle,
                         instance.image_blend, instance.image_alpha);
                 }
                 else {
@@ -1,12 +1,15 @@
 #pragma once
 
 #include <functional>
+#include <vector>
 #include <cstdint>
 
 struct GMLType;
 struct Instance;
 
 typedef unsigned int InstanceID;
+// Refers to one instance for as long as it's in the list. Handles stay valid when the list is compacted, and IsValid() can tell when one
+// has gone stale because its instance was removed.
 typedef unsigned int InstanceHandle;
 
 // This is like an std::vector of Instance objects. The list will ALWAYS be in order of instance id.
@@ -26,8 +29,10 @@ namespace InstanceList {
     unsigned int AddTile(unsigned int id, int background, int left, int top, unsigned int width, unsigned int height, double x, double y, int depth);
     unsigned int AddTile(int background, int left, int top, unsigned int width, unsigned int height, double x, double y, int depth);
 
-    // Restore list of instances
-    void AddInstances(const std::vector<Instance>& instances);
+    // Takes copies of the persistent instances, to carry them over a room change. RestorePersistent() adds them back at the end of the list.
+    // The copies' motion state isn't in _instanceMotion, so only their other variables should be looked at.
+    const std::vector<Instance>& BackupPersistent();
+    void RestorePersistent();
 
     // Remove all instances
     void ClearAll();
@@ -42,6 +47,7 @@ namespace InstanceList {
     bool DrawEverything();
 
     // Gets instance by a number. Similar to GML, if the number is > 100000 it'll be treated as an instance ID, otherwise an object ID.
+    // startPos and endPos are positions in iteration order, not handles.
     Instance* GetInstanceByNumber(unsigned int id, size_t startPos = 0, size_t* endPos = nullptr);
 
     // Gets a dummy instance for use in room creation code.
@@ -51,14 +57,28 @@ namespace InstanceList {
     // Get the number of active instances
     size_t Count();
 
+    // Gets the index into _instanceMotion of every instance that exists, in iteration order, for passes that run straight over the motion arrays
+    void GetMotionIndices(std::vector<unsigned int>& indices);
+
     // Set the next IDs to assign after all the static instances are loaded
     void SetLastIDs(unsigned int instance, unsigned int tile);
 
-    // Get instance reference from InstanceHandle
-    // Note: Instance references should NEVER be stored, as the underlying buffer may be reallocated at any time
+    // Get instance reference from InstanceHandle. The handle must be valid.
+    // Note: Instance references should NEVER be stored, as the instance's slot will be reused once it's removed - store the handle instead
     Instance& GetInstance(InstanceHandle);
 
-    // Getters and setters for instance fields
+    // Checks whether a handle still refers to an instance in the list. This is O(1).
+    bool IsValid(InstanceHandle);
+
+    // Gets where an instance is in iteration order. This changes when the list is compacted, so it's only good for comparing instances.
+    size_t GetPosition(InstanceHandle);
+
+    // Works out which fields each object's code uses, so its instances can keep them in slots. Call once, after CodeManager::CompileAll().
+    void BuildFieldLayouts();
+
+    // Getters and setters for instance fields. Array indices can also be given flattened, as in GMLArray.
+    // GetField() creates the field if it's never been set, so when it's only being read, ReadField() is better.
+    const GMLType& ReadField(InstanceHandle instance, uint32_t field, uint32_t index = 0);
     GMLType* GetField(InstanceHandle instance, uint32_t field);
     void SetField(InstanceHandle instance, uint32_t field, const GMLType& value);
     GMLType* GetField(InstanceHandle instance, uint32_t field, uint32_t array);
@@ -68,6 +88,7 @@ namespace InstanceList {
 
     // Iterator class for looping over instances. Has two modes of operation: all instances, or all matching a certain object/instance number.
     // Mode of operation is determined by which constructor is used. In other words, pass an ID if you want to iterate by that ID. Otherwise it will iterate all.
+    // Iterating by object only visits instances of that object and its children, so it doesn't matter how many other instances there are.
     class Iterator {
       private:
         bool _byId;
@@ -78,7 +99,6 @@ namespace InstanceList {
       public:
         Iterator() : _pos(0), _byId(false), _limit(InstanceList::Count()) {}
         Iterator(unsigned int id) : _pos(0), _id(id), _byId(true), _limit(InstanceList::Count()) {}
-        Iterator(unsigned int id, InstanceHandle startPos);
         InstanceHandle Next();
     };
 
@@ -0,0 +1,110 @@
+#include "MappedFile.hpp"
+#include <fstream>
+#include <new>
+
+#if defined(_WIN32)
+#define MAPPED_FILE_WIN32
+#include <windows.h>
+#elif (defined(__unix__) || defined(__APPLE__)) && !defined(__psp__)
+#define MAPPED_FILE_POSIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool _mapFile(const char* filename, MappedFile* file) {
+#if defined(MAPPED_FILE_POSIX)
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    // MAP_PRIVATE gives us copy-on-write pages: writes never reach the file, and untouched pages are never copied
+    void* addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED) return false;
+
+    file->data = static_cast<unsigned char*>(addr);
+    file->size = static_cast<size_t>(st.st_size);
+    file->mapped = true;
+    return true;
+#elif defined(MAPPED_FILE_WIN32)
+    HANDLE handle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size) || size.QuadPart <= 0) {
+        CloseHandle(handle);
+        return false;
+    }
+
+    // PAGE_WRITECOPY/FILE_MAP_COPY is Windows' equivalent of a private mapping
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(handle);
+    if (mapping == NULL) return false;
+
+    void* addr = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);
+    if (addr == NULL) return false;
+
+    file->data = static_cast<unsigned char*>(addr);
+    file->size = static_cast<size_t>(size.QuadPart);
+    file->mapped = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool _readFile(const char* filename, MappedFile* file) {
+    std::ifstream ifs(filename, std::ios::binary | std::ios::ate);
+    if (!ifs.is_open() || ifs.bad()) return false;
+
+    std::streamsize size = ifs.tellg();
+    if (size <= 0) return false;
+
+    try {
+        file->data = new unsigned char[static_cast<size_t>(size)];
+    }
+    catch (const std::bad_alloc&) {
+        return false;
+    }
+
+    ifs.seekg(std::ios::beg);
+    ifs.read(reinterpret_cast<char*>(file->data), size);
+    file->size = static_cast<size_t>(size);
+    file->mapped = false;
+    return true;
+}
+
+bool MapFile(const char* filename, MappedFile* file, bool allowMapping) {
+    file->data = nullptr;
+    file->size = 0;
+    file->mapped = false;
+
+    if (allowMapping && _mapFile(filename, file)) return true;
+    return _readFile(filename, file);
+}
+
+void UnmapFile(MappedFile* file) {
+    if (file->data) {
+        if (file->mapped) {
+#if defined(MAPPED_FILE_POSIX)
+            munmap(file->data, file->size);
+#elif defined(MAPPED_FILE_WIN32)
+            UnmapViewOfFile(file->data);
+#endif
+        }
+        else {
+            delete[] file->data;
+        }
+    }
+    file->data = nullptr;
+    file->size = 0;
+    file->mapped = false;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stddef.h>
+
+// A file opened for parsing. Where the platform supports it the file is memory-mapped with private (copy-on-write) pages,
+// so it can still be decrypted in place, but only the pages which actually get touched are read from disk or copied.
+// Otherwise the whole file is read into a heap buffer.
+struct MappedFile {
+    unsigned char* data;
+    size_t size;
+    bool mapped;
+};
+
+// Opens the given file. If allowMapping is false, or the platform can't map files, it will be read into memory instead.
+// Returns true on success, false on failure.
+bool MapFile(const char* filename, MappedFile* file, bool allowMapping = true);
+
+// Releases a file opened by MapFile. Any changes made to its data are discarded.
+void UnmapFile(MappedFile* file);
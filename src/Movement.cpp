@@ -0,0 +1,233 @@
+#include "Movement.hpp"
+#include "Constants.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Instances are moved this many at a time, each step going over the whole batch before the next starts. A batch's motion values
+// stay in the data cache between steps - that's only 16K on the PSP, so this shouldn't be made much bigger.
+constexpr size_t MOVEMENT_BATCH = 64;
+
+// Cos and sin of recently used angles. GML angles are usually whole numbers, and particles are often sent off at only a few of them,
+// so the same ones come up a lot. Entries are looked up by the exact bits of the angle, which gives exactly what cos() and sin() would.
+constexpr unsigned int TRIG_CACHE_BITS = 8;
+constexpr unsigned int TRIG_CACHE_SIZE = 1 << TRIG_CACHE_BITS;
+struct TrigEntry {
+    bool set = false;
+    uint64_t angle;  // Bits of the angle, in degrees
+    double cos;
+    double sin;
+};
+static TrigEntry _trigCache[TRIG_CACHE_SIZE];
+
+// Gets cos and sin of an angle in degrees, as cos(degrees * GML_PI / 180.0) and sin(degrees * GML_PI / 180.0)
+static inline const TrigEntry& _trig(double degrees) {
+    uint64_t bits;
+    memcpy(&bits, &degrees, sizeof(bits));
+    // Whole numbers leave the low mantissa bits zero, and powers of 2 times the same number (45, 90, 180, 360) only differ in the exponent,
+    // so take the index from the top of a Fibonacci hash: every bit of the angle gets mixed into those
+    TrigEntry& entry = _trigCache[(bits * 0x9E3779B97F4A7C15ULL) >> (64 - TRIG_CACHE_BITS)];
+    if (!entry.set || entry.angle != bits) {
+        entry.set = true;
+        entry.angle = bits;
+        entry.cos = cos(degrees * GML_PI / 180.0);
+        entry.sin = sin(degrees * GML_PI / 180.0);
+    }
+    return entry;
+}
+
+static void _applyBatch(InstanceMotion& motion, const unsigned int* indices, size_t count) {
+    for (size_t n = 0; n < count; n++) {
+        unsigned int i = indices[n];
+        if (motion.friction[i] == 0) continue;
+
+        // Subtract friction from speed towards 0
+        double speed = motion.speed[i];
+        if (speed < 0) {
+            speed += motion.friction[i];
+            if (speed > 0) speed = 0;
+        }
+        else {
+            speed -= motion.friction[i];
+            if (speed < 0) speed = 0;
+        }
+        motion.speed[i] = speed;
+
+        // Recalculate hspeed/vspeed
+        const TrigEntry& trig = _trig(motion.direction[i]);
+        motion.hspeed[i] = trig.cos * speed;
+        motion.vspeed[i] = -trig.sin * speed;
+    }
+
+    for (size_t n = 0; n < count; n++) {
+        unsigned int i = indices[n];
+        if (!motion.gravity[i]) continue;
+
+        // Apply gravity in gravity_direction to hspeed and vspeed
+        const TrigEntry& trig = _trig(motion.gravity_direction[i]);
+        double hspeed = motion.hspeed[i] + trig.cos * motion.gravity[i];
+        double vspeed = motion.vspeed[i] + -trig.sin * motion.gravity[i];
+        motion.hspeed[i] = hspeed;
+        motion.vspeed[i] = vspeed;
+
+        // Recalculate speed and direction from hspeed/vspeed. This has to stay pow() rather than multiplying: optimized builds turn it into
+        // a multiply anyway, but unoptimized ones don't, and pow() isn't always exactly the same.
+        motion.direction[i] = ::atan2(-vspeed, hspeed) * 180.0 / GML_PI;
+        motion.speed[i] = sqrt(pow(hspeed, 2) + pow(vspeed, 2));
+    }
+
+    // Apply hspeed and vspeed to x and y
+    for (size_t n = 0; n < count; n++) {
+        unsigned int i = indices[n];
+        motion.x[i] += motion.hspeed[i];
+        motion.y[i] += motion.vspeed[i];
+        if (motion.hspeed[i] || motion.vspeed[i]) motion.bboxIsStale[i] = true;
+    }
+}
+
+void ApplyMovement(InstanceMotion& motion, const std::vector<unsigned int>& indices) {
+    for (size_t start = 0; start < indices.size(); start += MOVEMENT_BATCH) {
+        _applyBatch(motion, indices.data() + start, std::min(MOVEMENT_BATCH, indices.size() - start));
+    }
+}
+
+#if _DEBUG
+// How movement used to be done, one instance at a time, for ApplyMovement() to be checked against
+static void _applyMovementReference(InstanceMotion& motion, unsigned int i) {
+    if (motion.friction[i] != 0) {
+        if (motion.speed[i] < 0) {
+            motion.speed[i] += motion.friction[i];
+            if (motion.speed[i] > 0) motion.speed[i] = 0;
+        }
+        else {
+            motion.speed[i] -= motion.friction[i];
+            if (motion.speed[i] < 0) motion.speed[i] = 0;
+        }
+        motion.hspeed[i] = cos(motion.direction[i] * GML_PI / 180.0) * motion.speed[i];
+        motion.vspeed[i] = -sin(motion.direction[i] * GML_PI / 180.0) * motion.speed[i];
+    }
+
+    if (motion.gravity[i]) {
+        motion.hspeed[i] += cos(motion.gravity_direction[i] * GML_PI / 180.0) * motion.gravity[i];
+        motion.vspeed[i] += -sin(motion.gravity_direction[i] * GML_PI / 180.0) * motion.gravity[i];
+        motion.direction[i] = ::atan2(-motion.vspeed[i], motion.hspeed[i]) * 180.0 / GML_PI;
+        motion.speed[i] = sqrt(pow(motion.hspeed[i], 2) + pow(motion.vspeed[i], 2));
+    }
+
+    motion.x[i] += motion.hspeed[i];
+    motion.y[i] += motion.vspeed[i];
+    if (motion.hspeed[i] || motion.vspeed[i]) motion.bboxIsStale[i] = true;
+}
+
+static bool _sameBits(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// A single instance's motion values, before and after one step, worked out by hand from how GM8 describes movement
+struct MovementCase {
+    const char* name;
+    double speed, direction, friction, gravity, gravityDirection;
+    double x, y, hspeed, vspeed, finalSpeed, finalDirection;
+    bool moved;
+};
+
+static const MovementCase _movementCases[] = {
+    // Friction takes speed towards 0, then hspeed and vspeed are worked out again from it
+    {"friction", 5, 0, 1, 0, 0, 4, 0, 4, 0, 4, 0, true},
+    // ...but never past it, whichever way it's going
+    {"friction stops at 0", -0.5, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, false},
+    // Gravity is added to hspeed and vspeed, with 270 being down, and speed and direction come from the result
+    {"gravity", 0, 0, 0, 1, 270, 0, 1, 0, 1, 1, -90, true},
+    // Friction happens before gravity
+    {"friction then gravity", 2, 0, 1, 1, 0, 2, 0, 2, 0, 2, 0, true},
+    // Nothing to do means nothing changes, including the bounding box
+    {"still", 0, 45, 0, 0, 0, 0, 0, 0, 0, 0, 45, false},
+};
+
+static bool _near(double a, double b) {
+    return fabs(a - b) < 1e-6;  // GML_PI is only good to about 9 places
+}
+#endif
+
+bool MovementUnitTest(std::ostream& out) {
+#if _DEBUG
+    constexpr unsigned int count = 1000;
+    constexpr unsigned int frames = 30;
+    InstanceMotion batched, reference;
+    batched.Resize(count);
+    std::vector<unsigned int> indices(count);
+
+    // Not the game's RNG, so running this doesn't change what a game does
+    uint32_t seed = 12345;
+    auto next = [&seed](int range) -> double {
+        seed = seed * 1103515245 + 12345;
+        return static_cast<double>((seed >> 8) % (range * 100)) / 100.0 - (range / 2);
+    };
+    for (unsigned int i = 0; i < count; i++) {
+        indices[i] = i;
+        batched.x[i] = next(640);
+        batched.y[i] = next(480);
+        batched.speed[i] = (i % 7 == 0) ? 0 : next(20);
+        // Some whole-number angles, so the trig cache gets hit, and some that will only come up once
+        batched.direction[i] = (i % 3 == 0) ? static_cast<double>(i % 8 * 45) : next(720);
+        batched.hspeed[i] = cos(batched.direction[i] * GML_PI / 180.0) * batched.speed[i];
+        batched.vspeed[i] = -sin(batched.direction[i] * GML_PI / 180.0) * batched.speed[i];
+        batched.friction[i] = (i % 2 == 0) ? 0 : next(2) / 4;
+        batched.gravity[i] = (i % 5 < 2) ? 0 : next(2);
+        batched.gravity_direction[i] = (i % 4 == 0) ? 270 : next(360);
+        batched.bboxIsStale[i] = false;
+    }
+    reference = batched;
+
+    bool ok = true;
+
+    // The reference is only the old loop, so anything both of them got wrong would slip through it. Check some cases with known answers too.
+    for (const MovementCase& c : _movementCases) {
+        InstanceMotion motion;
+        motion.Resize(1);
+        std::vector<unsigned int> one(1, 0);
+        motion.x[0] = 0;
+        motion.y[0] = 0;
+        motion.speed[0] = c.speed;
+        motion.direction[0] = c.direction;
+        motion.hspeed[0] = cos(c.direction * GML_PI / 180.0) * c.speed;
+        motion.vspeed[0] = -sin(c.direction * GML_PI / 180.0) * c.speed;
+        motion.friction[0] = c.friction;
+        motion.gravity[0] = c.gravity;
+        motion.gravity_direction[0] = c.gravityDirection;
+        motion.bboxIsStale[0] = false;
+        ApplyMovement(motion, one);
+        if (_near(motion.x[0], c.x) && _near(motion.y[0], c.y) && _near(motion.hspeed[0], c.hspeed) && _near(motion.vspeed[0], c.vspeed) &&
+            _near(motion.speed[0], c.finalSpeed) && _near(motion.direction[0], c.finalDirection) && motion.bboxIsStale[0] == c.moved) {
+            continue;
+        }
+        out << "Movement case \"" << c.name << "\" failed: x " << motion.x[0] << ", y " << motion.y[0] << ", hspeed " << motion.hspeed[0] << ", vspeed "
+            << motion.vspeed[0] << ", speed " << motion.speed[0] << ", direction " << motion.direction[0] << "\n";
+        ok = false;
+    }
+
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        ApplyMovement(batched, indices);
+        for (unsigned int i = 0; i < count; i++) _applyMovementReference(reference, i);
+
+        for (unsigned int i = 0; i < count; i++) {
+            if (_sameBits(batched.x[i], reference.x[i]) && _sameBits(batched.y[i], reference.y[i]) && _sameBits(batched.hspeed[i], reference.hspeed[i]) &&
+                _sameBits(batched.vspeed[i], reference.vspeed[i]) && _sameBits(batched.speed[i], reference.speed[i]) &&
+                _sameBits(batched.direction[i], reference.direction[i]) && batched.bboxIsStale[i] == reference.bboxIsStale[i]) {
+                continue;
+            }
+            out << "Movement mismatch on frame " << frame << " for instance " << i << ": x " << batched.x[i] << " vs " << reference.x[i] << ", y " << batched.y[i]
+                << " vs " << reference.y[i] << ", speed " << batched.speed[i] << " vs " << reference.speed[i] << ", direction " << batched.direction[i] << " vs "
+                << reference.direction[i] << "\n";
+            ok = false;
+        }
+        if (!ok) break;
+    }
+    out << (ok ? "Movement unit test passed\n" : "Movement unit test failed\n");
+    return ok;
+#else
+    (void)out;
+    return true;
+#endif
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "Instance.hpp"
+#include <ostream>
+#include <vector>
+
+// Does the movement part of a step for these instances: friction, then gravity, then hspeed and vspeed are added to x and y.
+// The indices are into motion. Results are exactly the same as working through the instances one at a time the way GM8 does.
+void ApplyMovement(InstanceMotion& motion, const std::vector<unsigned int>& indices);
+
+// Checks ApplyMovement() on some cases with known answers, then against the one-at-a-time version on a lot of made-up instances,
+// writing out any that didn't match (the latter to the last bit) and then whether it passed. Returns true if everything matched.
+// Only does anything in debug builds.
+bool MovementUnitTest(std::ostream& out);